@@ -0,0 +1,74 @@
+#include "assetwatcher.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+/**
+ * @brief AssetWatcher::isEnabled Tells whether assets are loaded from disk.
+ * @return True if the ASSET_DIR environment variable is set.
+ */
+bool AssetWatcher::isEnabled() { return !qEnvironmentVariableIsEmpty("ASSET_DIR"); }
+
+/**
+ * @brief AssetWatcher::resolve Returns the path an asset is read from.
+ * @param resource Resource path of the asset, such as ":/models/knot.obj".
+ * @return The file below ASSET_DIR in development mode if it exists, the
+ * resource path otherwise.
+ */
+QString AssetWatcher::resolve(const QString &resource) {
+  if (!isEnabled() || !resource.startsWith(":/")) return resource;
+  QString path = QDir(qEnvironmentVariable("ASSET_DIR")).filePath(resource.mid(2));
+  return QFileInfo::exists(path) ? path : resource;
+}
+
+/**
+ * @brief AssetWatcher::AssetWatcher Starts watching the shaders and models
+ * below ASSET_DIR.
+ * @param parent Parent object.
+ */
+AssetWatcher::AssetWatcher(QObject *parent) : QObject(parent) {
+  QDir root(qEnvironmentVariable("ASSET_DIR"));
+  for (const QString &directory : {"shaders", "models"}) {
+    QDir dir(root.filePath(directory));
+    for (const QString &name : dir.entryList(QDir::Files)) {
+      QString path = dir.filePath(name);
+      resources.insert(path, ":/" + directory + "/" + name);
+      watch(path);
+    }
+  }
+  qDebug() << ":: Watching" << resources.size() << "assets in" << root.path();
+
+  settleTimer.setSingleShot(true);
+  settleTimer.setInterval(settleTime);
+  connect(&settleTimer, &QTimer::timeout, this, &AssetWatcher::emitChanges);
+  connect(&watcher, &QFileSystemWatcher::fileChanged, this,
+          [this](const QString &path) {
+            pending.insert(path);
+            settleTimer.start();
+          });
+}
+
+/**
+ * @brief AssetWatcher::watch Adds a file to the watcher unless it is already
+ * watched or missing, as in the middle of being replaced.
+ * @param path Path of the file.
+ */
+void AssetWatcher::watch(const QString &path) {
+  if (!watcher.files().contains(path) && QFileInfo::exists(path)) {
+    watcher.addPath(path);
+  }
+}
+
+/**
+ * @brief AssetWatcher::emitChanges Reports the files changed since the last
+ * call, once no more writes came in for the settle time.
+ */
+void AssetWatcher::emitChanges() {
+  QSet<QString> paths;
+  paths.swap(pending);
+  for (const QString &path : paths) {
+    watch(path);
+    qDebug() << ":: Reloading" << resources.value(path);
+    emit changed(resources.value(path), ++changes);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef ASSETWATCHER_H
+#define ASSETWATCHER_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+/**
+ * @brief Development mode: reads the shaders and models from the source tree
+ * instead of the resources, and reports when they change.
+ *
+ * The mode is enabled by pointing the ASSET_DIR environment variable at the
+ * directory holding shaders/ and models/. Resource paths such as
+ * ":/shaders/vertshader.glsl" then resolve to the file of the same name below
+ * it, so an edited asset is used without rebuilding the resources. Every file
+ * of those directories is watched; editors that save by replacing a file
+ * remove it from the watcher, so changed files are watched again. Changes
+ * are reported once a burst of writes has settled, by resource path.
+ *
+ * Each change carries a serial number, so the first view to handle it can
+ * reload the shared objects and the others only their own.
+ */
+class AssetWatcher : public QObject {
+  Q_OBJECT
+
+ public:
+  static bool isEnabled();
+  static QString resolve(const QString &resource);
+
+  explicit AssetWatcher(QObject *parent = nullptr);
+
+  // Called after a reload that every view has to pick up
+  void notifyReloaded() { emit reloaded(); }
+
+ signals:
+  void changed(const QString &resource, int change);
+  void reloaded();
+
+ private:
+  static constexpr int settleTime = 100;  // milliseconds
+
+  void watch(const QString &path);
+  void emitChanges();
+
+  QFileSystemWatcher watcher;
+  QHash<QString, QString> resources;  // resource paths by file path
+  QSet<QString> pending;
+  QTimer settleTimer;
+  int changes = 0;
+};
+
+#endif  // ASSETWATCHER_H
@@ -0,0 +1,87 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+#include <QVector>
+#include <cfloat>
+#include <cmath>
+
+// Defining an axis-aligned bounding box, used for culling and level of detail
+struct AABB {
+  QVector3D lower{FLT_MAX, FLT_MAX, FLT_MAX};
+  QVector3D upper{-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+  bool isEmpty() const { return lower.x() > upper.x(); }
+
+  QVector3D center() const { return (lower + upper) * 0.5f; }
+  QVector3D extent() const { return (upper - lower) * 0.5f; }
+  float radius() const { return extent().length(); }
+
+  void expand(const QVector3D &p) {
+    lower = QVector3D(std::fmin(lower.x(), p.x()), std::fmin(lower.y(), p.y()),
+                      std::fmin(lower.z(), p.z()));
+    upper = QVector3D(std::fmax(upper.x(), p.x()), std::fmax(upper.y(), p.y()),
+                      std::fmax(upper.z(), p.z()));
+  }
+
+  void expand(const AABB &other) {
+    if (other.isEmpty()) return;
+    expand(other.lower);
+    expand(other.upper);
+  }
+
+  // Transforms the box and returns the box enclosing the result (Arvo's method)
+  AABB transformed(const QMatrix4x4 &m) const {
+    if (isEmpty()) return *this;
+    QVector3D c = m.map(center());
+    QVector3D e = extent();
+    QVector3D r;
+    for (int i = 0; i < 3; i++) {
+      r[i] = std::fabs(m(i, 0)) * e.x() + std::fabs(m(i, 1)) * e.y() +
+             std::fabs(m(i, 2)) * e.z();
+    }
+    return AABB{c - r, c + r};
+  }
+
+  static AABB fromPoints(const QVector<QVector3D> &points) {
+    AABB box;
+    for (const QVector3D &p : points) box.expand(p);
+    return box;
+  }
+};
+
+// Defining the six planes of a view frustum, with normals pointing inwards
+struct Frustum {
+  QVector4D planes[6];
+
+  // Extracts the normalized planes from the rows of a (view-)projection matrix
+  static Frustum fromMatrix(const QMatrix4x4 &m) {
+    Frustum frustum;
+    QVector4D w = m.row(3);
+    for (int i = 0; i < 3; i++) {
+      QVector4D row = m.row(i);
+      QVector4D left = w + row;
+      QVector4D right = w - row;
+      frustum.planes[2 * i] = left / left.toVector3D().length();
+      frustum.planes[2 * i + 1] = right / right.toVector3D().length();
+    }
+    return frustum;
+  }
+
+  bool intersects(const AABB &box) const {
+    if (box.isEmpty()) return false;
+    QVector3D c = box.center();
+    QVector3D e = box.extent();
+    for (const QVector4D &p : planes) {
+      float distance = p.x() * c.x() + p.y() * c.y() + p.z() * c.z() + p.w();
+      float radius = std::fabs(p.x()) * e.x() + std::fabs(p.y()) * e.y() +
+                     std::fabs(p.z()) * e.z();
+      if (distance < -radius) return false;
+    }
+    return true;
+  }
+};
+
+#endif  // BOUNDS_H
@@ -0,0 +1,160 @@
+#include "impostoratlas.h"
+
+#include <QtMath>
+
+namespace {
+
+// Angle between the rows of views, the middle row is seen from the side
+const float elevationStep = 45.0f;
+
+}  // namespace
+
+/**
+ * @brief ImpostorAtlas::bake Renders the mesh from every view into the color
+ * and depth atlas. Restores the framebuffer and viewport afterwards.
+ * Expects an unlit scene program for the mesh to be bound.
+ * @param gl OpenGL functions of the current context.
+ * @param mesh The mesh with the vertex arrays of the current context.
+ * @param modelLocation Location of the model transformation uniform.
+ * @param viewLocation Location of the view transformation uniform.
+ * @param projectionLocation Location of the projection transformation uniform.
+ */
+void ImpostorAtlas::bake(QOpenGLFunctions_3_3_Core *gl, const Mesh &mesh,
+                         GLint modelLocation, GLint viewLocation,
+                         GLint projectionLocation) {
+  bounds = mesh.bounds;
+
+  const int width = azimuths * viewSize;
+  const int height = elevations * viewSize;
+
+  gl->glGenTextures(1, &colorTexture);
+  gl->glBindTexture(GL_TEXTURE_2D, colorTexture);
+  gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, nullptr);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  gl->glGenTextures(1, &depthTexture);
+  gl->glBindTexture(GL_TEXTURE_2D, depthTexture);
+  gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0,
+                   GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  GLint previousFramebuffer;
+  GLint previousViewport[4];
+  GLfloat previousClearColor[4];
+  gl->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  gl->glGetIntegerv(GL_VIEWPORT, previousViewport);
+  gl->glGetFloatv(GL_COLOR_CLEAR_VALUE, previousClearColor);
+
+  GLuint framebuffer;
+  gl->glGenFramebuffers(1, &framebuffer);
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D, colorTexture, 0);
+  gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                             depthTexture, 0);
+  if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    qDebug() << ":: Impostor framebuffer incomplete";
+  }
+
+  // Transparent background, so the quads can discard what the mesh misses
+  gl->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // The camera sits two radii from the center; the sphere spans depth 0 to 1
+  float radius = bounds.radius();
+  QMatrix4x4 projection;
+  projection.ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+  gl->glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, projection.data());
+  gl->glUniformMatrix4fv(viewLocation, 1, GL_FALSE, QMatrix4x4().constData());
+
+  gl->glBindVertexArray(mesh.vao);
+  for (int e = 0; e < elevations; e++) {
+    for (int a = 0; a < azimuths; a++) {
+      float azimuth = qDegreesToRadians(360.0f * a / azimuths);
+      float elevation = qDegreesToRadians(elevationStep * (e - elevations / 2));
+      QVector3D direction(sin(azimuth) * cos(elevation), sin(elevation),
+                          cos(azimuth) * cos(elevation));
+
+      QMatrix4x4 view;
+      view.lookAt(bounds.center() + 2.0f * radius * direction, bounds.center(),
+                  QVector3D(0, 1, 0));
+      gl->glUniformMatrix4fv(modelLocation, 1, GL_FALSE, view.data());
+
+      gl->glViewport(a * viewSize, e * viewSize, viewSize, viewSize);
+      gl->glDrawArrays(GL_TRIANGLES, 0, mesh.count);
+    }
+  }
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  gl->glDeleteFramebuffers(1, &framebuffer);
+  gl->glViewport(previousViewport[0], previousViewport[1], previousViewport[2],
+                 previousViewport[3]);
+  gl->glClearColor(previousClearColor[0], previousClearColor[1],
+                   previousClearColor[2], previousClearColor[3]);
+
+  drawProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                      ":/shaders/impostorvertshader.glsl");
+  drawProgram.addShaderFromSourceFile(QOpenGLShader::Fragment,
+                                      ":/shaders/impostorfragshader.glsl");
+  drawProgram.link();
+  projLoc = drawProgram.uniformLocation("projectionTransform");
+  viewLoc = drawProgram.uniformLocation("viewTransform");
+  boundsCenterLoc = drawProgram.uniformLocation("boundsCenter");
+  boundsRadiusLoc = drawProgram.uniformLocation("boundsRadius");
+
+  drawProgram.bind();
+  gl->glUniform1i(drawProgram.uniformLocation("colorAtlas"), 0);
+  gl->glUniform1i(drawProgram.uniformLocation("depthAtlas"), 1);
+  drawProgram.release();
+}
+
+/**
+ * @brief ImpostorAtlas::destroy Deletes the atlas textures.
+ * @param gl OpenGL functions of a current context of the group.
+ */
+void ImpostorAtlas::destroy(QOpenGLFunctions_3_3_Core *gl) {
+  gl->glDeleteTextures(1, &colorTexture);
+  gl->glDeleteTextures(1, &depthTexture);
+  colorTexture = depthTexture = 0;
+}
+
+/**
+ * @brief ImpostorAtlas::getAllocatedBytes Returns the size of the atlas
+ * textures, 4 bytes per texel each.
+ * @return Size in bytes, 0 before baking.
+ */
+qint64 ImpostorAtlas::getAllocatedBytes() const {
+  if (!isBaked()) return 0;
+  return qint64(azimuths * viewSize) * (elevations * viewSize) * 8;
+}
+
+/**
+ * @brief ImpostorAtlas::draw Draws impostors with one instanced draw call.
+ * @param gl OpenGL functions of the current context.
+ * @param instanceVAO VAO with the instance transformations at locations 0 to 3,
+ * advancing once per instance.
+ * @param instanceCount Number of instances.
+ * @param projection Projection transformation.
+ * @param view View transformation.
+ */
+void ImpostorAtlas::draw(QOpenGLFunctions_3_3_Core *gl, GLuint instanceVAO,
+                         GLsizei instanceCount, const QMatrix4x4 &projection,
+                         const QMatrix4x4 &view) {
+  drawProgram.bind();
+  gl->glUniformMatrix4fv(projLoc, 1, GL_FALSE, projection.data());
+  gl->glUniformMatrix4fv(viewLoc, 1, GL_FALSE, view.constData());
+  QVector3D center = bounds.center();
+  gl->glUniform3f(boundsCenterLoc, center.x(), center.y(), center.z());
+  gl->glUniform1f(boundsRadiusLoc, bounds.radius());
+
+  gl->glActiveTexture(GL_TEXTURE1);
+  gl->glBindTexture(GL_TEXTURE_2D, depthTexture);
+  gl->glActiveTexture(GL_TEXTURE0);
+  gl->glBindTexture(GL_TEXTURE_2D, colorTexture);
+
+  gl->glBindVertexArray(instanceVAO);
+  gl->glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceCount);
+  drawProgram.release();
+}
@@ -0,0 +1,50 @@
+#ifndef IMPOSTORATLAS_H
+#define IMPOSTORATLAS_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+
+#include "mesh.h"
+
+/**
+ * @brief Multi-view impostor of a mesh, for drawing distant instances.
+ *
+ * The mesh is rendered offscreen from a ring of azimuths at a few elevations,
+ * with an orthographic camera fitted to its bounding sphere. Color and depth of
+ * all views are stored in one atlas. Distant instances are then drawn as quads
+ * facing the eye that sample the view closest to their direction, and that
+ * reconstruct their depth from the atlas so they still intersect correctly
+ * with other geometry.
+ *
+ * The framebuffer the atlas is baked through is deleted afterwards.
+ */
+class ImpostorAtlas {
+ public:
+  static constexpr int azimuths = 8;
+  static constexpr int elevations = 3;
+  static constexpr int viewSize = 128;
+
+  void bake(QOpenGLFunctions_3_3_Core *gl, const Mesh &mesh,
+            GLint modelLocation, GLint viewLocation, GLint projectionLocation);
+  void destroy(QOpenGLFunctions_3_3_Core *gl);
+  bool isBaked() const { return colorTexture != 0; }
+  qint64 getAllocatedBytes() const;
+
+  void draw(QOpenGLFunctions_3_3_Core *gl, GLuint instanceVAO,
+            GLsizei instanceCount, const QMatrix4x4 &projection,
+            const QMatrix4x4 &view);
+
+ private:
+  AABB bounds;
+  GLuint colorTexture = 0;
+  GLuint depthTexture = 0;
+
+  QOpenGLShaderProgram drawProgram;
+  GLint projLoc;
+  GLint viewLoc;
+  GLint boundsCenterLoc;
+  GLint boundsRadiusLoc;
+};
+
+#endif  // IMPOSTORATLAS_H
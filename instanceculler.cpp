@@ -0,0 +1,457 @@
+#include "instanceculler.h"
+
+#include <cfloat>
+#include <cstddef>
+
+#include "programcache.h"
+#include "vertex.h"
+
+/**
+ * @brief InstanceCuller::Shared::initialize Compiles the culling and drawing
+ * programs. The culling program captures the four columns of every visible
+ * instance transformation with transform feedback.
+ * @param gl OpenGL functions of the current context.
+ * @param cache Cache the drawing programs are built through.
+ */
+void InstanceCuller::Shared::initialize(QOpenGLFunctions_3_3_Core *gl,
+                                        ProgramCache &cache) {
+  cullProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                      ":/shaders/cullvertshader.glsl");
+  cullProgram.addShaderFromSourceFile(QOpenGLShader::Geometry,
+                                      ":/shaders/cullgeomshader.glsl");
+  const char *varyings[] = {"instanceColumn0", "instanceColumn1",
+                            "instanceColumn2", "instanceColumn3"};
+  gl->glTransformFeedbackVaryings(cullProgram.programId(), 4, varyings,
+                                  GL_INTERLEAVED_ATTRIBS);
+  cullProgram.link();
+
+  boundsCenterLoc = cullProgram.uniformLocation("boundsCenter");
+  boundsExtentLoc = cullProgram.uniformLocation("boundsExtent");
+  frustumPlanesLoc = cullProgram.uniformLocation("frustumPlanes");
+  cullViewLoc = cullProgram.uniformLocation("viewTransform");
+  minDistanceLoc = cullProgram.uniformLocation("minDistance");
+  maxDistanceLoc = cullProgram.uniformLocation("maxDistance");
+
+  // Both variants up front, batches of either kind can be added later
+  programCache = &cache;
+  positionOnlyFeature = drawShaders.featureBit("POSITION_ONLY");
+  drawShaders.get(cache, 0);
+  drawShaders.get(cache, positionOnlyFeature);
+}
+
+/**
+ * @brief InstanceCuller::Shared::destroy Deletes the instance buffers of all
+ * batches.
+ * @param gl OpenGL functions of a current context of the group.
+ */
+void InstanceCuller::Shared::destroy(QOpenGLFunctions_3_3_Core *gl) {
+  for (Batch &batch : batches) gl->glDeleteBuffers(1, &batch.instanceVBO);
+  batches.clear();
+}
+
+/**
+ * @brief InstanceCuller::Shared::reloadShaders Rebuilds the drawing programs
+ * if they use a changed shader.
+ * @param path Resource path of the shader.
+ */
+void InstanceCuller::Shared::reloadShaders(const QString &path) {
+  if (programCache) drawShaders.reload(*programCache, path);
+}
+
+/**
+ * @brief InstanceCuller::Shared::addBatch Creates a batch of instances of one
+ * mesh.
+ * @param gl OpenGL functions of the current context.
+ * @param mesh The mesh, its VBO is shared with the batch.
+ * @param transforms Model transformation of every instance.
+ * @return Index of the batch.
+ */
+int InstanceCuller::Shared::addBatch(QOpenGLFunctions_3_3_Core *gl,
+                                     const Mesh &mesh,
+                                     const QVector<QMatrix4x4> &transforms) {
+  Batch batch;
+  batch.meshVBO = mesh.vbo;
+  batch.positionOnly = mesh.positionOnly;
+  batch.vertexCount = mesh.count;
+  batch.bounds = mesh.bounds;
+  gl->glGenBuffers(1, &batch.instanceVBO);
+
+  batches.append(batch);
+  setTransforms(gl, batches.size() - 1, transforms);
+  return batches.size() - 1;
+}
+
+/**
+ * @brief InstanceCuller::Shared::updateMesh Takes over the vertex count and
+ * bounds of a mesh whose buffer was filled with new vertices, for every batch
+ * of it.
+ * @param mesh The mesh, with the VBO it was added with.
+ */
+void InstanceCuller::Shared::updateMesh(const Mesh &mesh) {
+  for (Batch &batch : batches) {
+    if (batch.meshVBO != mesh.vbo) continue;
+    batch.vertexCount = mesh.count;
+    batch.bounds = mesh.bounds;
+  }
+}
+
+/**
+ * @brief InstanceCuller::Shared::setTransforms Replaces the instance
+ * transformations of a batch. The views resize their culled buffers to match
+ * before they cull next.
+ * @param gl OpenGL functions of the current context.
+ * @param batch Index of the batch.
+ * @param transforms Model transformation of every instance.
+ */
+void InstanceCuller::Shared::setTransforms(
+    QOpenGLFunctions_3_3_Core *gl, int batch,
+    const QVector<QMatrix4x4> &transforms) {
+  Batch &b = batches[batch];
+  b.instanceCount = transforms.size();
+
+  QVector<GLfloat> data;
+  data.reserve(16 * transforms.size());
+  for (const QMatrix4x4 &transform : transforms) {
+    const float *m = transform.constData();
+    for (int i = 0; i < 16; i++) data.append(m[i]);
+  }
+
+  gl->glBindBuffer(GL_ARRAY_BUFFER, b.instanceVBO);
+  gl->glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLfloat),
+                   data.constData(), GL_STATIC_DRAW);
+}
+
+/**
+ * @brief InstanceCuller::Shared::setImpostor Draws the instances of a batch
+ * beyond a distance from the eye as impostors.
+ * @param batch Index of the batch.
+ * @param atlas Impostor baked from the batch's mesh, not owned.
+ * @param distance Distance from which instances are drawn as impostors.
+ */
+void InstanceCuller::Shared::setImpostor(int batch, ImpostorAtlas *atlas,
+                                         float distance) {
+  batches[batch].impostor = atlas;
+  batches[batch].impostorDistance = distance;
+}
+
+/**
+ * @brief InstanceCuller::Shared::getAllocatedBytes Returns the size of the
+ * instance buffers.
+ * @return Size in bytes.
+ */
+qint64 InstanceCuller::Shared::getAllocatedBytes() const {
+  qint64 bytes = 0;
+  for (const Batch &batch : batches) {
+    bytes += batch.instanceCount * 16 * sizeof(GLfloat);
+  }
+  return bytes;
+}
+
+/**
+ * @brief InstanceCuller::initialize Sets up culling of the shared batches into
+ * buffers of this view, and creates those of the current batches.
+ * @param functions OpenGL functions of the current context.
+ * @param shared Batches and programs of the context group.
+ */
+void InstanceCuller::initialize(QOpenGLFunctions_3_3_Core *functions,
+                                Shared *shared) {
+  gl = functions;
+  this->shared = shared;
+  synchronize();
+}
+
+/**
+ * @brief InstanceCuller::destroy Deletes the buffers, vertex arrays and
+ * queries of this view.
+ */
+void InstanceCuller::destroy() {
+  if (!gl) return;
+  for (Batch &batch : batches) {
+    gl->glDeleteVertexArrays(1, &batch.cullVAO);
+    for (CulledInstances *instances : {&batch.visible, &batch.impostors}) {
+      gl->glDeleteBuffers(2, instances->buffers);
+      gl->glDeleteVertexArrays(2, instances->vertexArrays);
+      gl->glDeleteQueries(2, instances->queries);
+    }
+  }
+  batches.clear();
+  shared = nullptr;
+  gl = nullptr;
+}
+
+/**
+ * @brief InstanceCuller::getAllocatedBytes Returns the size of the buffers
+ * this view culls into.
+ * @return Size in bytes.
+ */
+qint64 InstanceCuller::getAllocatedBytes() const {
+  qint64 bytes = 0;
+  for (const Batch &batch : batches) {
+    int buffers = batch.impostors.buffers[0] ? 4 : 2;
+    bytes += buffers * batch.capacity * 16 * sizeof(GLfloat);
+  }
+  return bytes;
+}
+
+/**
+ * @brief InstanceCuller::specifyInstanceLayout Specifies four consecutive vec4
+ * attributes for the columns of a mat4, read from the bound GL_ARRAY_BUFFER.
+ * @param gl OpenGL functions.
+ * @param firstLocation Location of the first column.
+ * @param divisor Attribute divisor, 1 to advance once per instance.
+ */
+void InstanceCuller::specifyInstanceLayout(QOpenGLFunctions_3_3_Core *gl,
+                                           GLuint firstLocation,
+                                           GLuint divisor) {
+  for (GLuint i = 0; i < 4; i++) {
+    gl->glEnableVertexAttribArray(firstLocation + i);
+    gl->glVertexAttribPointer(firstLocation + i, 4, GL_FLOAT, GL_FALSE,
+                              16 * sizeof(GLfloat),
+                              (void *)(sizeof(GLfloat) * 4 * i));
+    gl->glVertexAttribDivisor(firstLocation + i, divisor);
+  }
+}
+
+/**
+ * @brief InstanceCuller::synchronize Creates the buffers of this view for
+ * batches added since the last frame, and resizes those of batches whose
+ * transformations were replaced.
+ */
+void InstanceCuller::synchronize() {
+  while (batches.size() < shared->batches.size()) {
+    // Culling reads one point per instance from the shared instance buffer
+    const Shared::Batch &source = shared->batches[batches.size()];
+    Batch batch;
+    gl->glGenVertexArrays(1, &batch.cullVAO);
+    gl->glBindVertexArray(batch.cullVAO);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, source.instanceVBO);
+    specifyInstanceLayout(gl, 0, 0);
+    gl->glBindVertexArray(0);
+    batches.append(batch);
+  }
+
+  for (int i = 0; i < batches.size(); i++) {
+    const Shared::Batch &source = shared->batches[i];
+    Batch &batch = batches[i];
+    // New buffers are sized below with the others
+    if (!batch.visible.buffers[0]) {
+      createCulledInstances(batch.visible, source, false);
+      batch.capacity = -1;
+    }
+    if (source.impostor && !batch.impostors.buffers[0]) {
+      createCulledInstances(batch.impostors, source, true);
+      batch.capacity = -1;
+    }
+    if (batch.capacity == source.instanceCount) continue;
+
+    GLsizeiptr size = source.instanceCount * 16 * sizeof(GLfloat);
+    for (CulledInstances *instances : {&batch.visible, &batch.impostors}) {
+      if (!instances->buffers[0]) continue;
+      for (GLuint buffer : instances->buffers) {
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        gl->glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+      }
+      // The new storage holds no instances, whatever the queries report
+      instances->reset();
+    }
+    batch.capacity = source.instanceCount;
+  }
+}
+
+/**
+ * @brief InstanceCuller::createCulledInstances Creates the buffers culled
+ * into, their vertex arrays and queries. The buffers are sized by
+ * synchronize().
+ * @param instances Receives the objects.
+ * @param batch The shared batch.
+ * @param impostor Whether the vertex arrays draw impostors, which read the
+ * instances only, rather than the mesh with the instances.
+ */
+void InstanceCuller::createCulledInstances(CulledInstances &instances,
+                                           const Shared::Batch &batch,
+                                           bool impostor) {
+  gl->glGenBuffers(2, instances.buffers);
+  gl->glGenVertexArrays(2, instances.vertexArrays);
+  gl->glGenQueries(2, instances.queries);
+
+  for (int i = 0; i < 2; i++) {
+    gl->glBindVertexArray(instances.vertexArrays[i]);
+    if (!impostor) {
+      // Drawing reads the mesh per vertex and the visible instances per
+      // instance
+      gl->glBindBuffer(GL_ARRAY_BUFFER, batch.meshVBO);
+      if (batch.positionOnly) {
+        positionFormat.specify(gl);
+      } else {
+        vertexFormat.specify(gl);
+      }
+    }
+    gl->glBindBuffer(GL_ARRAY_BUFFER, instances.buffers[i]);
+    specifyInstanceLayout(gl, impostor ? 0 : 2, 1);
+  }
+  gl->glBindVertexArray(0);
+}
+
+/**
+ * @brief InstanceCuller::cull Writes the instances of every batch whose bounds
+ * intersect the view frustum to the batch's visible buffer. Rasterization is
+ * disabled while culling.
+ * @param projection Projection transformation.
+ * @param view Transformation from world space to view space.
+ * @param wait Whether to wait for the GPU rather than skip culling into a
+ * buffer whose count is still pending, for a frame that stays on screen.
+ */
+void InstanceCuller::cull(const QMatrix4x4 &projection, const QMatrix4x4 &view,
+                          bool wait) {
+  synchronize();
+
+  Frustum frustum = Frustum::fromMatrix(projection * view);
+  GLfloat planes[6 * 4];
+  for (int i = 0; i < 6; i++) {
+    for (int k = 0; k < 4; k++) planes[i * 4 + k] = frustum.planes[i][k];
+  }
+
+  shared->cullProgram.bind();
+  gl->glUniform4fv(shared->frustumPlanesLoc, 6, planes);
+  gl->glUniformMatrix4fv(shared->cullViewLoc, 1, GL_FALSE, view.constData());
+  gl->glEnable(GL_RASTERIZER_DISCARD);
+
+  for (int i = 0; i < batches.size(); i++) {
+    const Shared::Batch &source = shared->batches[i];
+    Batch &batch = batches[i];
+    float maxDistance = source.impostor ? source.impostorDistance : FLT_MAX;
+    cullInto(source, batch.cullVAO, batch.visible, 0.0f, maxDistance, wait);
+    if (source.impostor) {
+      cullInto(source, batch.cullVAO, batch.impostors, source.impostorDistance,
+               FLT_MAX, wait);
+    }
+  }
+
+  gl->glDisable(GL_RASTERIZER_DISCARD);
+  gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  shared->cullProgram.release();
+}
+
+/**
+ * @brief InstanceCuller::cullInto Captures the instances of a batch that are
+ * inside the frustum and within a range of distances from the eye, into the
+ * buffer not drawn. Skipped while that buffer's count is still pending,
+ * unless waiting for it, which makes it the buffer drawn. Expects the culling program to be bound and rasterization to be discarded.
+ * @param batch The shared batch.
+ * @param cullVAO Vertex array of this view reading the batch's instances.
+ * @param instances Buffers and queries receiving the visible instances.
+ * @param minDistance Closest distance of the center of an instance.
+ * @param maxDistance Distance from which instances are excluded.
+ * @param wait Whether to wait for a pending count.
+ */
+void InstanceCuller::cullInto(const Shared::Batch &batch, GLuint cullVAO,
+                              CulledInstances &instances, float minDistance,
+                              float maxDistance, bool wait) {
+  int target = instances.drawn == 0 ? 1 : 0;
+  if (instances.pending[target]) {
+    if (!wait) return;
+    target = 1 - resolve(instances, true);
+  }
+  GLuint query = instances.queries[target];
+
+  gl->glUniform3f(shared->boundsCenterLoc, batch.bounds.center().x(),
+                  batch.bounds.center().y(), batch.bounds.center().z());
+  gl->glUniform3f(shared->boundsExtentLoc, batch.bounds.extent().x(),
+                  batch.bounds.extent().y(), batch.bounds.extent().z());
+  gl->glUniform1f(shared->minDistanceLoc, minDistance);
+  gl->glUniform1f(shared->maxDistanceLoc, maxDistance);
+
+  gl->glBindVertexArray(cullVAO);
+  gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0,
+                       instances.buffers[target]);
+  gl->glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
+  gl->glBeginTransformFeedback(GL_POINTS);
+  gl->glDrawArrays(GL_POINTS, 0, batch.instanceCount);
+  gl->glEndTransformFeedback();
+  gl->glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+  instances.pending[target] = true;
+}
+
+/**
+ * @brief InstanceCuller::CulledInstances::reset Forgets the instances of both
+ * buffers, after their storage was replaced.
+ */
+void InstanceCuller::CulledInstances::reset() {
+  for (int i = 0; i < 2; i++) {
+    pending[i] = false;
+    counts[i] = 0;
+  }
+  drawn = -1;
+}
+
+/**
+ * @brief InstanceCuller::resolve Switches to the buffer culled into last once
+ * its count is read back.
+ * @param instances Instances culled into two buffers in turn.
+ * @param wait Whether to wait for the count rather than keep drawing the
+ * other buffer.
+ * @return Buffer to draw, with a known count, or -1 if there is none yet.
+ */
+int InstanceCuller::resolve(CulledInstances &instances, bool wait) {
+  int culled = instances.drawn == 0 ? 1 : 0;
+  if (instances.pending[culled]) {
+    GLuint available = GL_TRUE;
+    if (!wait) {
+      gl->glGetQueryObjectuiv(instances.queries[culled],
+                              GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (available) {
+      gl->glGetQueryObjectuiv(instances.queries[culled], GL_QUERY_RESULT,
+                              &instances.counts[culled]);
+      instances.pending[culled] = false;
+      instances.drawn = culled;
+    }
+  }
+  return instances.drawn;
+}
+
+/**
+ * @brief InstanceCuller::draw Draws the newest culled instances of every batch
+ * whose count is known, with one instanced draw call per batch, and one more
+ * for its impostors.
+ * @param projection Projection transformation.
+ * @param view View transformation.
+ * @param wait Whether to wait for the counts of the instances culled last,
+ * for a frame that stays on screen.
+ */
+void InstanceCuller::draw(const QMatrix4x4 &projection, const QMatrix4x4 &view,
+                          bool wait) {
+  ShaderVariants::Variant *bound = nullptr;
+  for (int i = 0; i < batches.size(); i++) {
+    const Shared::Batch &source = shared->batches[i];
+    Batch &batch = batches[i];
+    int drawn = resolve(batch.visible, wait);
+    if (drawn < 0 || batch.visible.counts[drawn] == 0) continue;
+
+    quint32 mask = source.positionOnly ? shared->positionOnlyFeature : 0;
+    ShaderVariants::Variant *variant =
+        &shared->drawShaders.get(*shared->programCache, mask);
+    if (variant != bound) {
+      variant->program.bind();
+      gl->glUniformMatrix4fv(variant->location(Shared::ProjectionUniform), 1,
+                             GL_FALSE, projection.constData());
+      gl->glUniformMatrix4fv(variant->location(Shared::ViewUniform), 1,
+                             GL_FALSE, view.constData());
+      bound = variant;
+    }
+    gl->glBindVertexArray(batch.visible.vertexArrays[drawn]);
+    gl->glDrawArraysInstanced(GL_TRIANGLES, 0, source.vertexCount,
+                              batch.visible.counts[drawn]);
+  }
+  if (bound) bound->program.release();
+
+  for (int i = 0; i < batches.size(); i++) {
+    const Shared::Batch &source = shared->batches[i];
+    if (!source.impostor) continue;
+    CulledInstances &impostors = batches[i].impostors;
+    int drawn = resolve(impostors, wait);
+    if (drawn < 0 || impostors.counts[drawn] == 0) continue;
+    source.impostor->draw(gl, impostors.vertexArrays[drawn],
+                          impostors.counts[drawn], projection, view);
+  }
+}
@@ -0,0 +1,149 @@
+#ifndef INSTANCECULLER_H
+#define INSTANCECULLER_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+
+#include "impostoratlas.h"
+#include "mesh.h"
+#include "shadervariants.h"
+#include "vertex.h"
+
+/**
+ * @brief Frustum culling of instanced meshes on the GPU.
+ *
+ * Each batch holds the model transformations of many instances of one mesh in
+ * a buffer. Every frame, one point per instance is sent through a culling
+ * program that tests the transformed mesh bounds against the frustum; the
+ * geometry shader only emits the visible ones, which transform feedback
+ * captures into a second buffer. That buffer is then used directly as the
+ * per-instance attribute stream of an instanced draw, so per-instance
+ * visibility never leaves the GPU. Only the number of captured instances is
+ * read back, from a GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query.
+ *
+ * Reading a query in the frame that issued it would wait for the GPU, so the
+ * visible instances and impostors are culled into two buffers in turn. Each
+ * buffer is drawn with its own count only: the one culled last is drawn once
+ * its query reports the count available, until then the other one is drawn.
+ * While the GPU is behind, culling skips a frame rather than overwrite the
+ * buffer being drawn. Instances thus appear and disappear a frame or more
+ * late, except in a final frame, which waits for the count.
+ *
+ * Batches can have an impostor: instances beyond its distance are culled into
+ * a second buffer in a separate pass and drawn as impostor quads instead.
+ *
+ * The batches and the programs are kept in InstanceCuller::Shared; every view
+ * culls them into its own buffers, with its own vertex arrays and queries.
+ */
+class InstanceCuller {
+ public:
+  // Batches and programs of all views
+  class Shared {
+   public:
+    void initialize(QOpenGLFunctions_3_3_Core *gl, ProgramCache &cache);
+    void destroy(QOpenGLFunctions_3_3_Core *gl);
+    void reloadShaders(const QString &path);
+    bool isEmpty() const { return batches.isEmpty(); }
+
+    int addBatch(QOpenGLFunctions_3_3_Core *gl, const Mesh &mesh,
+                 const QVector<QMatrix4x4> &transforms);
+    void setTransforms(QOpenGLFunctions_3_3_Core *gl, int batch,
+                       const QVector<QMatrix4x4> &transforms);
+    void setImpostor(int batch, ImpostorAtlas *atlas, float distance);
+    void updateMesh(const Mesh &mesh);
+    qint64 getAllocatedBytes() const;
+
+   private:
+    friend class InstanceCuller;
+
+    struct Batch {
+      GLuint meshVBO;
+      bool positionOnly;
+      GLsizei vertexCount;
+      AABB bounds;
+
+      GLuint instanceVBO = 0;
+      GLsizei instanceCount = 0;
+
+      ImpostorAtlas *impostor = nullptr;
+      float impostorDistance = 0.0f;
+    };
+
+    QVector<Batch> batches;
+
+    QOpenGLShaderProgram cullProgram;
+    GLint boundsCenterLoc;
+    GLint boundsExtentLoc;
+    GLint frustumPlanesLoc;
+    GLint cullViewLoc;
+    GLint minDistanceLoc;
+    GLint maxDistanceLoc;
+
+    // Drawing programs, in variants for meshes with stored colors and for
+    // position-only meshes
+    enum DrawUniform { ProjectionUniform, ViewUniform };
+    ShaderVariants drawShaders{":/shaders/instancevertshader.glsl",
+                               ":/shaders/fragshader.glsl",
+                               {"projectionTransform", "viewTransform"},
+                               vertexFormat.declarations()};
+    ProgramCache *programCache = nullptr;
+    quint32 positionOnlyFeature = 0;
+  };
+
+  void initialize(QOpenGLFunctions_3_3_Core *functions, Shared *shared);
+  void destroy();
+  bool isEmpty() const { return !shared; }
+
+  void cull(const QMatrix4x4 &projection, const QMatrix4x4 &view,
+            bool wait = false);
+  void draw(const QMatrix4x4 &projection, const QMatrix4x4 &view,
+            bool wait = false);
+
+  GLuint getVisibleCount(int batch) const {
+    return batches[batch].visible.drawnCount();
+  }
+  GLuint getImpostorCount(int batch) const {
+    return batches[batch].impostors.drawnCount();
+  }
+  qint64 getAllocatedBytes() const;
+
+ private:
+  // Instances culled into two buffers in turn, see above
+  struct CulledInstances {
+    GLuint buffers[2] = {};
+    GLuint vertexArrays[2] = {};
+    GLuint queries[2] = {};
+    bool pending[2] = {};   // culled into, count not read back yet
+    GLuint counts[2] = {};  // known instances of each buffer
+    int drawn = -1;         // buffer with the newest known count, or -1
+
+    GLuint drawnCount() const { return drawn < 0 ? 0 : counts[drawn]; }
+    void reset();
+  };
+
+  // What this view keeps of a shared batch
+  struct Batch {
+    GLuint cullVAO = 0;
+    GLsizei capacity = 0;  // instances the buffers below hold
+    CulledInstances visible;
+    CulledInstances impostors;
+  };
+
+  static void specifyInstanceLayout(QOpenGLFunctions_3_3_Core *gl,
+                                    GLuint firstLocation, GLuint divisor);
+  void synchronize();
+  void createCulledInstances(CulledInstances &instances,
+                             const Shared::Batch &batch, bool impostor);
+  void cullInto(const Shared::Batch &batch, GLuint cullVAO,
+                CulledInstances &instances, float minDistance,
+                float maxDistance, bool wait);
+  int resolve(CulledInstances &instances, bool wait);
+
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+  Shared *shared = nullptr;
+  QVector<Batch> batches;  // by the index of the shared batch
+};
+
+#endif  // INSTANCECULLER_H
@@ -0,0 +1,170 @@
+#include "lightclusters.h"
+
+#include <QThread>
+#include <cmath>
+
+/**
+ * @brief LightClusters::initialize Creates the texture buffer objects.
+ * @param gl OpenGL functions of the current context.
+ */
+void LightClusters::initialize(QOpenGLFunctions_3_3_Core *gl) {
+  clusterLights.resize(clusterCount);
+
+  GLuint *buffers[] = {&lightBuffer, &indexBuffer, &gridBuffer};
+  GLuint *textures[] = {&lightTexture, &indexTexture, &gridTexture};
+  GLenum formats[] = {GL_RGBA32F, GL_R32UI, GL_RG32UI};
+  for (int i = 0; i < 3; i++) {
+    gl->glGenBuffers(1, buffers[i]);
+    gl->glBindBuffer(GL_TEXTURE_BUFFER, *buffers[i]);
+    gl->glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    gl->glGenTextures(1, textures[i]);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, *textures[i]);
+    gl->glTexBuffer(GL_TEXTURE_BUFFER, formats[i], *buffers[i]);
+  }
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+  allocatedBytes = 3 * 16;
+}
+
+/**
+ * @brief LightClusters::destroy Deletes the buffers and textures.
+ * @param gl OpenGL functions of a current context of the group.
+ */
+void LightClusters::destroy(QOpenGLFunctions_3_3_Core *gl) {
+  GLuint buffers[] = {lightBuffer, indexBuffer, gridBuffer};
+  GLuint textures[] = {lightTexture, indexTexture, gridTexture};
+  gl->glDeleteBuffers(3, buffers);
+  gl->glDeleteTextures(3, textures);
+  allocatedBytes = 0;
+}
+
+/**
+ * @brief LightClusters::assign Assigns the lights to the clusters and uploads
+ * the result.
+ * @param gl OpenGL functions of the current context.
+ * @param lights The lights, in view space.
+ * @param projection Symmetric perspective or orthographic projection of the
+ * view.
+ * @param nearPlane Distance to the near plane of the projection.
+ * @param farPlane Distance to the far plane of the projection.
+ */
+void LightClusters::assign(QOpenGLFunctions_3_3_Core *gl,
+                           const QVector<PointLight> &lights,
+                           const QMatrix4x4 &projection, float nearPlane,
+                           float farPlane) {
+  this->lights = lights;
+  this->projection = projection;
+  this->nearPlane = nearPlane;
+  this->farPlane = farPlane;
+
+  // Every task owns a range of slices, so the clusters it writes are disjoint
+  int tasks = qBound(1, QThread::idealThreadCount(), gridZ);
+  int slicesPerTask = (gridZ + tasks - 1) / tasks;
+  for (int z = 0; z < gridZ; z += slicesPerTask) {
+    int end = std::min(z + slicesPerTask, gridZ);
+    pool.start([this, z, end] { assignSlices(z, end); });
+  }
+  pool.waitForDone();
+
+  // Flattening the lists into one index buffer with an (offset, count) grid
+  QVector<GLuint> indices;
+  QVector<GLuint> grid;
+  grid.reserve(2 * clusterCount);
+  for (const QVector<GLuint> &cluster : clusterLights) {
+    grid.append(indices.size());
+    grid.append(cluster.size());
+    indices.append(cluster);
+  }
+  if (indices.isEmpty()) indices.append(0);
+
+  QVector<GLfloat> data;
+  data.reserve(8 * lights.size());
+  for (const PointLight &light : lights) {
+    data.append(light.position.x());
+    data.append(light.position.y());
+    data.append(light.position.z());
+    data.append(light.radius);
+    data.append(light.color.x());
+    data.append(light.color.y());
+    data.append(light.color.z());
+    data.append(0.0f);
+  }
+  if (data.isEmpty()) data.fill(0.0f, 8);
+
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+  gl->glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(GLfloat),
+                   data.constData(), GL_STREAM_DRAW);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+  gl->glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(GLuint),
+                   indices.constData(), GL_STREAM_DRAW);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+  gl->glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(GLuint),
+                   grid.constData(), GL_STREAM_DRAW);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  allocatedBytes = data.size() * sizeof(GLfloat) +
+                   (indices.size() + grid.size()) * sizeof(GLuint);
+}
+
+/**
+ * @brief LightClusters::assignSlices Finds the lights overlapping every cluster
+ * in the depth slices [sliceStart, sliceEnd), by testing their spheres against
+ * the view-space bounding box of the cluster.
+ * @param sliceStart First depth slice.
+ * @param sliceEnd Slice after the last depth slice.
+ */
+void LightClusters::assignSlices(int sliceStart, int sliceEnd) {
+  // At distance d, a normalized device coordinate n maps to n * d / scale in
+  // a perspective projection, and to n / scale at any distance in an
+  // orthographic one
+  float scaleX = projection(0, 0);
+  float scaleY = projection(1, 1);
+  bool orthographic = projection(3, 3) == 1.0f;
+
+  for (int z = sliceStart; z < sliceEnd; z++) {
+    float sliceNear = nearPlane * std::pow(farPlane / nearPlane, float(z) / gridZ);
+    float sliceFar = nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / gridZ);
+    float nearScale = orthographic ? 1.0f : sliceNear;
+    float farScale = orthographic ? 1.0f : sliceFar;
+
+    for (int y = 0; y < gridY; y++) {
+      float y0 = -1.0f + 2.0f * y / gridY;
+      float y1 = -1.0f + 2.0f * (y + 1) / gridY;
+      float minY = std::fmin(y0 * nearScale, y0 * farScale) / scaleY;
+      float maxY = std::fmax(y1 * nearScale, y1 * farScale) / scaleY;
+
+      for (int x = 0; x < gridX; x++) {
+        float x0 = -1.0f + 2.0f * x / gridX;
+        float x1 = -1.0f + 2.0f * (x + 1) / gridX;
+        float minX = std::fmin(x0 * nearScale, x0 * farScale) / scaleX;
+        float maxX = std::fmax(x1 * nearScale, x1 * farScale) / scaleX;
+
+        QVector<GLuint> &cluster = clusterLights[(z * gridY + y) * gridX + x];
+        cluster.clear();
+        for (int i = 0; i < lights.size(); i++) {
+          const QVector3D &p = lights[i].position;
+          float dx = p.x() - qBound(minX, p.x(), maxX);
+          float dy = p.y() - qBound(minY, p.y(), maxY);
+          float dz = p.z() - qBound(-sliceFar, p.z(), -sliceNear);
+          if (dx * dx + dy * dy + dz * dz <= lights[i].radius * lights[i].radius) {
+            cluster.append(i);
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief LightClusters::bind Binds the light data, light indices and cluster
+ * grid to three consecutive texture units.
+ * @param gl OpenGL functions of the current context.
+ * @param firstUnit Unit of the light data, e.g. GL_TEXTURE1.
+ */
+void LightClusters::bind(QOpenGLFunctions_3_3_Core *gl, GLenum firstUnit) {
+  GLuint textures[] = {lightTexture, indexTexture, gridTexture};
+  for (int i = 0; i < 3; i++) {
+    gl->glActiveTexture(firstUnit + i);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+  }
+  gl->glActiveTexture(GL_TEXTURE0);
+}
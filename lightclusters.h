@@ -0,0 +1,67 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QThreadPool>
+#include <QVector3D>
+#include <QVector>
+
+// Defining a point light in view space, with a finite range
+struct PointLight {
+  QVector3D position;
+  float radius;
+  QVector3D color;
+};
+
+/**
+ * @brief Assigns point lights to a 3D grid of clusters over the view frustum,
+ * for clustered forward shading.
+ *
+ * The frustum, perspective or orthographic, is divided in screen tiles and
+ * exponentially spaced depth slices.
+ * Every frame, the lights overlapping each cluster are found on the CPU, with
+ * the depth slices spread over a thread pool. The light data, the concatenated
+ * per-cluster light indices and the (offset, count) of every cluster are then
+ * uploaded to texture buffer objects, so a fragment shader only loops over the
+ * lights of its own cluster.
+ *
+ * Every view assigns its lights in turn before drawing.
+ */
+class LightClusters {
+ public:
+  static constexpr int gridX = 16;
+  static constexpr int gridY = 9;
+  static constexpr int gridZ = 24;
+  static constexpr int clusterCount = gridX * gridY * gridZ;
+
+  void initialize(QOpenGLFunctions_3_3_Core *gl);
+  void destroy(QOpenGLFunctions_3_3_Core *gl);
+
+  void assign(QOpenGLFunctions_3_3_Core *gl, const QVector<PointLight> &lights,
+              const QMatrix4x4 &projection, float nearPlane, float farPlane);
+  void bind(QOpenGLFunctions_3_3_Core *gl, GLenum firstUnit);
+  qint64 getAllocatedBytes() const { return allocatedBytes; }
+
+ private:
+  void assignSlices(int sliceStart, int sliceEnd);
+
+  QThreadPool pool;
+
+  QVector<PointLight> lights;
+  QMatrix4x4 projection;
+  float nearPlane;
+  float farPlane;
+  QVector<QVector<GLuint>> clusterLights;
+
+  // Buffers and the buffer textures viewing them
+  GLuint lightBuffer = 0;
+  GLuint lightTexture = 0;
+  GLuint indexBuffer = 0;
+  GLuint indexTexture = 0;
+  GLuint gridBuffer = 0;
+  GLuint gridTexture = 0;
+  qint64 allocatedBytes = 0;
+};
+
+#endif  // LIGHTCLUSTERS_H
@@ -0,0 +1,94 @@
+#include "lod.h"
+
+#include <QHash>
+#include <cmath>
+
+namespace {
+
+/**
+ * @brief cellKey Packs the grid cell of a position into one key.
+ * @param p The position.
+ * @param cellSize Edge length of the cells.
+ * @return Key of the cell, 21 bits per axis.
+ */
+quint64 cellKey(const QVector3D &p, float cellSize) {
+  auto axis = [cellSize](float v) {
+    return static_cast<quint64>(static_cast<qint64>(std::floor(v / cellSize)) &
+                                0x1FFFFF);
+  };
+  return axis(p.x()) | axis(p.y()) << 21 | axis(p.z()) << 42;
+}
+
+}  // namespace
+
+/**
+ * @brief clusterIndices Simplifies a triangle mesh by vertex clustering. All
+ * vertices in a grid cell collapse onto the existing vertex closest to the
+ * average of the cell, so the simplified mesh can share the vertex buffer of
+ * the original. Triangles that become degenerate are dropped.
+ * @param positions Positions of the vertices.
+ * @param indices Triangle indices into positions.
+ * @param cellSize Edge length of the grid cells.
+ * @return Triangle indices of the simplified mesh.
+ */
+QVector<unsigned> clusterIndices(const QVector<QVector3D> &positions,
+                                 const QVector<unsigned> &indices,
+                                 float cellSize) {
+  // Averaging the vertices of every cell
+  QHash<quint64, QVector3D> sums;
+  QHash<quint64, int> counts;
+  for (const QVector3D &p : positions) {
+    quint64 key = cellKey(p, cellSize);
+    sums[key] += p;
+    counts[key] += 1;
+  }
+
+  // Picking the vertex closest to the average as representative
+  QHash<quint64, unsigned> representatives;
+  QHash<quint64, float> distances;
+  for (int i = 0; i < positions.size(); i++) {
+    quint64 key = cellKey(positions[i], cellSize);
+    QVector3D average = sums[key] / counts[key];
+    float distance = (positions[i] - average).lengthSquared();
+    if (!representatives.contains(key) || distance < distances[key]) {
+      representatives[key] = i;
+      distances[key] = distance;
+    }
+  }
+
+  QVector<unsigned> simplified;
+  for (int i = 0; i + 2 < indices.size(); i += 3) {
+    unsigned a = representatives[cellKey(positions[indices[i]], cellSize)];
+    unsigned b = representatives[cellKey(positions[indices[i + 1]], cellSize)];
+    unsigned c = representatives[cellKey(positions[indices[i + 2]], cellSize)];
+    if (a == b || b == c || a == c) continue;
+    simplified.append(a);
+    simplified.append(b);
+    simplified.append(c);
+  }
+  return simplified;
+}
+
+/**
+ * @brief selectLod Picks the coarsest level whose error, projected to the
+ * screen, stays within the tolerance. Starting from the current level, it
+ * refines as soon as the error exceeds the tolerance, but only coarsens once the
+ * coarser level is clearly below it.
+ * @param lods Levels of the mesh, finest first.
+ * @param current Level used in the previous frame.
+ * @param projectedRadius Radius of the bounding sphere on screen, in pixels.
+ * @param tolerance Maximum error on screen, in pixels.
+ * @return The level to draw.
+ */
+int selectLod(const QVector<LodLevel> &lods, int current, float projectedRadius,
+              float tolerance) {
+  int level = qBound(0, current, lods.size() - 1);
+  while (level > 0 && lods[level].error * projectedRadius > tolerance) {
+    level--;
+  }
+  while (level + 1 < lods.size() &&
+         lods[level + 1].error * projectedRadius <= tolerance * lodHysteresis) {
+    level++;
+  }
+  return level;
+}
@@ -0,0 +1,28 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector3D>
+#include <QVector>
+
+// Defining one level of detail: a range in the element buffer of a mesh
+struct LodLevel {
+  GLuint first;
+  GLsizei count;
+
+  // Geometric error of the level, relative to the radius of the mesh bounds
+  float error;
+};
+
+// Levels are switched to a coarser one only once its projected error is below
+// this fraction of the tolerance, to avoid popping back and forth
+const float lodHysteresis = 0.7f;
+
+QVector<unsigned> clusterIndices(const QVector<QVector3D> &positions,
+                                 const QVector<unsigned> &indices,
+                                 float cellSize);
+
+int selectLod(const QVector<LodLevel> &lods, int current,
+              float projectedRadius, float tolerance);
+
+#endif  // LOD_H
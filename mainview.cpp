@@ -1,9 +1,41 @@
 #include "mainview.h"
+#include "scenegeometry.h"
 #include "vertex.h"
 #include <cstddef>
 #include <iostream>
 
 #include <QDateTime>
+#include <QRandomGenerator>
+#include <QtMath>
+
+namespace {
+
+// Model added to the scene by loadModelInBackground()
+const QString streamedModel = ":/models/knot.obj";
+
+// Programs of the shared geometry built from one vertex and one fragment
+// shader, with the vertex inputs generated from their vertex format
+struct ProgramSources {
+  QOpenGLShaderProgram SharedGeometry::*program;
+  QString vertex;
+  QString fragment;
+  QByteArray vertexInputs;
+
+  QVector<ProgramCache::Stage> stages() const {
+    return {{QOpenGLShader::Vertex, vertex, vertexInputs},
+            {QOpenGLShader::Fragment, fragment, QByteArray()}};
+  }
+};
+
+const ProgramSources programSources[] = {
+    {&SharedGeometry::prepassProgram, ":/shaders/prepassvertshader.glsl",
+     ":/shaders/prepassfragshader.glsl", positionFormat.declarations()},
+    {&SharedGeometry::depthViewProgram, ":/shaders/depthviewvertshader.glsl",
+     ":/shaders/depthviewfragshader.glsl", QByteArray()},
+    {&SharedGeometry::upscaleProgram, ":/shaders/depthviewvertshader.glsl",
+     ":/shaders/upscalefragshader.glsl", QByteArray()}};
+
+}  // namespace
 
 /**
  * @brief MainView::MainView Constructs a new main view.
@@ -13,6 +45,10 @@
 MainView::MainView(QWidget *parent) : QOpenGLWidget(parent) {
   qDebug() << "MainView constructor";
 
+  // Keeping the framebuffer between frames, so a frame without changes does
+  // not need to be drawn again
+  setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+
   connect(&timer, SIGNAL(timeout()), this, SLOT(update()));
 }
 
@@ -26,11 +62,36 @@ MainView::MainView(QWidget *parent) : QOpenGLWidget(parent) {
  */
 MainView::~MainView() {
   qDebug() << "MainView destructor";
-  glDeleteBuffers(1, &buffer);
-  glDeleteVertexArrays(1, &array);
-  glDeleteBuffers(1, &knotVBO);
-  glDeleteVertexArrays(1, &knotVAO);
+  delete uploadWorker;
   makeCurrent();
+  occlusionCuller.destroy();
+  instanceCuller.destroy();
+  postChain.destroy();
+  frameGraph.destroy();
+  resolutionController.destroy();
+  vertexPuller.destroy();
+  knotDeformer.destroy();
+  glDeleteTextures(1, &occluderDepthTexture);
+  for (ShadowMap &shadowMap : shadowMaps) shadowMap.destroy(this);
+  glDeleteFramebuffers(2, shadowFramebuffers);
+  glDeleteVertexArrays(2, particleVAOs);
+  glDeleteVertexArrays(1, &emptyVAO);
+  if (staticKnot.vao) meshes[KnotMesh] = staticKnot;
+  for (Mesh &mesh : meshes) {
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteVertexArrays(1, &mesh.positionVAO);
+  }
+  for (int i = shared ? shared->meshes.size() : 0; i < meshes.size(); i++) {
+    shared->memoryBudget.setEvictionHandler(meshes[i].resource, nullptr);
+    shared->memoryBudget.remove(this, meshes[i].resource);
+  }
+  if (shared) {
+    shared->memoryBudget.remove(this, targetResource);
+    shared->memoryBudget.remove(this, cullResource);
+    shared->memoryBudget.remove(this, shadowResource);
+    shared->removeView(this);
+    shared->release(this);
+  }
 }
 
 // --- OpenGL initialization
@@ -67,44 +128,79 @@ void MainView::initializeGL() {
   // color.
   glClearColor(0.37f, 0.42f, 0.45f, 0.0f);
 
-  // Loading knot model from the model directory
-  Model knot(":/models/knot.obj");
-
-  // Getting vertex coordinates of the knot model
-  QVector<QVector3D> knotVertices = knot.getMeshCoords();
-  Vertex knotArray[knotVertices.count()];
-  for (int i = 0; i < knotVertices.count(); i++) {
-      knotArray[i].x = knotVertices[i].x();
-      knotArray[i].y = knotVertices[i].y();
-      knotArray[i].z = knotVertices[i].z();
-      knotArray[i].r = abs(knotVertices[i].x());
-      knotArray[i].g = abs(knotVertices[i].y());
-      knotArray[i].b = abs(knotVertices[i].z());
-  }
-
-  // Generating VBO and VAO for both pyramid and knot
-  glGenBuffers(1, &buffer);
-  glGenBuffers(1, &knotVBO);
-  glGenVertexArrays(1, &array);
-  glGenVertexArrays(1, &knotVAO);
-
+  // Meshes and programs are uploaded by the first view of the window, and
+  // shared with the others; every view creates its own vertex arrays
+  shared = SharedGeometry::acquire(context());
   createShaderProgram();
+  if (shared->isEmpty()) {
+    uploadMeshes();
+    createSharedResources();
+  }
+  meshes = shared->meshes;
+  meshGeneration = shared->meshGeneration;
+  for (Mesh &mesh : meshes) createVertexArrays(mesh);
+
+  // Development mode: assets edited on disk are reloaded while running
+  if (AssetWatcher::isEnabled()) {
+    if (!shared->assetWatcher) shared->assetWatcher = new AssetWatcher;
+    connect(shared->assetWatcher, &AssetWatcher::changed, this,
+            &MainView::reloadAsset);
+    connect(shared->assetWatcher, &AssetWatcher::reloaded, this,
+            [this] { invalidate(SceneDirty); });
+  }
+
+  // Building the scene graph, using the given translations
+  pyramidNode = scene.addChild("pyramid");
+  pyramidNode->setMesh(PyramidMesh, meshes[PyramidMesh].bounds);
+  pyramidNode->setTranslation(QVector3D(-2, 0, -6));
+  knotNode = scene.addChild("knot");
+  knotNode->setMesh(KnotMesh, meshes[KnotMesh].bounds);
+  knotNode->setTranslation(QVector3D(2, 0, -6));
+  floorNode = scene.addChild("floor");
+  floorNode->setMesh(FloorMesh, meshes[FloorMesh].bounds);
+  floorNode->setTranslation(QVector3D(0, -2.6f, -8));
+  floorNode->setScale(QVector3D(10, 1, 10));
 
-  // Filling VBO with vertex array of the pyramid
-  fillArrayAndBuffer(buffer, array, 18, pyramid);
+  occlusionCuller.initialize(this);
 
-  // Specifying how the data is laid out for the pyramid
-  specifyDataLayout();
+  // Registering the pyramid and the knot as occluders for the software
+  // occlusion culling
+  for (int mesh : shared->occluderCoords.keys()) {
+    meshes[mesh].occluder = softwareOccluder.addOccluder(
+        shared->occluderCoords[mesh], shared->occluderIndices[mesh]);
+  }
+
+  // A few hundred colored point lights scattered around the objects
+  QRandomGenerator random(42);
+  for (int i = 0; i < 256; i++) {
+    PointLight light;
+    light.position = QVector3D(random.bounded(12.0) - 6.0, random.bounded(6.0) - 3.0,
+                               -1.0 - random.bounded(13.0));
+    light.radius = 1.5f + random.bounded(1.5f);
+    light.color = QVector3D(random.bounded(1.0f), random.bounded(1.0f),
+                            random.bounded(1.0f));
+    lights.append(light);
+  }
 
-  // Filling VBO with vertex array of the knot
-  fillArrayAndBuffer(knotVBO, knotVAO, 3840, knotArray);
+  createShadowMaps();
 
-  // Specifying how the data is laid out for the knot
-  specifyDataLayout();
+  postChain.initialize(this, &shared->postPrograms);
+  updatePostEffects();
+  frameGraph.initialize(this);
+  targetResource = shared->memoryBudget.add("render targets", 0, {}, {}, false);
+  cullResource = shared->memoryBudget.add("culled instances", 0, {}, {}, false);
+  vertexPuller.initialize(this);
+  resolutionController.initialize(this);
+  resolutionController.setDevicePixelRatio(devicePixelRatioF());
 
-  // Setting Model transformation using the given translations
-  model.translate(-2, 0, -6);
-  knotModel.translate(2, 0, -6);
+  // Texture and program used to show the software depth buffer
+  glGenTextures(1, &occluderDepthTexture);
+  glBindTexture(GL_TEXTURE_2D, occluderDepthTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SoftwareOccluder::width,
+               SoftwareOccluder::height, 0, GL_RED, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glGenVertexArrays(1, &emptyVAO);
 
   // Setting Projection transformations using the given information
   projection.perspective(60.0, 4.0/3.0, 0.2, 20.0);
@@ -114,23 +210,601 @@ void MainView::initializeGL() {
  * @brief MainView::specifyDataLayout Specifying how the data is laid out for the different objects
  */
 void MainView::specifyDataLayout(){
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, x));
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, r));
+  vertexFormat.specify(this);
+}
+
+/**
+ * @brief MainView::uploadMeshes Loads the meshes and uploads them into the
+ * shared geometry. Only called by the first view of the window.
+ */
+void MainView::uploadMeshes() {
+  // Loading knot model from the model directory
+  Model knot(AssetWatcher::resolve(":/models/knot.obj"));
+  QVector<QVector3D> knotCoords = knot.getMeshCoords();
+  QVector<Vertex> pyramid = pyramidVertices();
+  QVector<Vertex> floor = floorVertices();
+
+  // Uploading the pyramid and the knot, in the order of the mesh indices. The
+  // colors of the knot follow from its positions, so only those are stored
+  addMesh(pyramid.size(), pyramid.data());
+  addPositionMesh(knotCoords);
+  buildLods(KnotMesh, knotCoords);
+  addMesh(floor.size(), floor.data());
+  shared->vertexPool.build(this, shared->meshes);
+
+  QVector<QVector3D> pyramidCoords;
+  QVector<unsigned> pyramidIndices;
+  for (int i = 0; i < pyramid.size(); i++) {
+    pyramidCoords.append(QVector3D(pyramid[i].x, pyramid[i].y, pyramid[i].z));
+    pyramidIndices.append(i);
+  }
+  shared->occluderCoords.insert(PyramidMesh, pyramidCoords);
+  shared->occluderIndices.insert(PyramidMesh, pyramidIndices);
+  shared->occluderCoords.insert(KnotMesh, knot.getCoords());
+  shared->occluderIndices.insert(KnotMesh, knot.getTriangleIndices());
+
+  // The shared meshes are referenced by the vertex pool and by the vertex
+  // arrays of every view, so they only count towards the budget
+  bool ok;
+  int megabytes = qEnvironmentVariableIntValue("GPU_MEMORY_BUDGET_MB", &ok);
+  if (ok) shared->memoryBudget.setBudget(qint64(megabytes) << 20);
+  const QString sources[] = {"pyramid", ":/models/knot.obj", "floor"};
+  for (int i = 0; i < shared->meshes.size(); i++) {
+    Mesh &mesh = shared->meshes[i];
+    qint64 bytes = mesh.count * qint64(mesh.positionOnly
+                                           ? sizeof(VertexPosition)
+                                           : sizeof(Vertex) + sizeof(VertexPosition));
+    for (const LodLevel &level : mesh.lods) bytes += level.count * sizeof(GLuint);
+    QVector<GLuint> buffers = {mesh.positionVBO, mesh.ebo};
+    if (!mesh.positionOnly) buffers.prepend(mesh.vbo);
+    mesh.resource = shared->memoryBudget.add(sources[i], bytes, buffers, {}, false);
+  }
+  shared->poolResource = shared->memoryBudget.add(
+      "vertex pool", shared->vertexPool.getAllocatedBytes(), {}, {}, false);
+}
+
+/**
+ * @brief MainView::createSharedResources Creates the light clusters and the
+ * post-processing programs. Only called by the first view of the window.
+ */
+void MainView::createSharedResources() {
+  shared->lightClusters.initialize(this);
+
+  // The buffers are deleted with the group, so they only count towards the
+  // budget
+  shared->clusterResource = shared->memoryBudget.add(
+      "light clusters", shared->lightClusters.getAllocatedBytes(), {}, {}, false);
+
+  shared->postPrograms.initialize();
+}
+
+/**
+ * @brief MainView::createShadowMaps Creates the shadow maps of a sun over the
+ * objects and a spot light from the left, with the framebuffers rendering into
+ * them.
+ */
+void MainView::createShadowMaps() {
+  ShadowLight sun;
+  sun.type = ShadowLight::Directional;
+  sun.position = QVector3D(0, -1, -6);
+  sun.direction = QVector3D(0.3f, -1.0f, -0.4f).normalized();
+  sun.range = 6.0f;
+  sun.color = QVector3D(0.6f, 0.55f, 0.5f);
+  ShadowLight spot;
+  spot.type = ShadowLight::Spot;
+  spot.position = QVector3D(-6, 3, -3);
+  spot.direction = (QVector3D(1, -1, -6) - spot.position).normalized();
+  spot.range = 16.0f;
+  spot.angle = 35.0f;
+  spot.color = QVector3D(0.7f, 0.7f, 0.9f);
+  shadowMaps[0].initialize(this);
+  shadowMaps[0].setLight(sun);
+  shadowMaps[1].initialize(this);
+  shadowMaps[1].setLight(spot);
+
+  qint64 bytes = 0;
+  for (int i = 0; i < 2; i++) {
+    shadowFramebuffers[i] = shadowMaps[i].createFramebuffer(this);
+    bytes += shadowMaps[i].getAllocatedBytes();
+  }
+  shadowResource = shared->memoryBudget.add("shadow maps", bytes, {}, {}, false);
+}
+
+/**
+ * @brief MainView::buildInstanceField Creates the field of small knots on the
+ * ground, mostly outside of the frustum, when a view first shows it; the other
+ * views cull the same field.
+ */
+void MainView::buildInstanceField() {
+  InstanceCuller::Shared &instances = shared->instances;
+  if (instances.isEmpty()) {
+    instances.initialize(this, shared->programCache);
+    QVector<QMatrix4x4> transforms;
+    for (int i = 0; i < 256; i++) {
+      for (int j = 0; j < 256; j++) {
+        QMatrix4x4 transform;
+        transform.translate(-32.0f + 0.25f * i, -2.5f, -1.0f - 0.25f * j);
+        transform.scale(0.05f);
+        transforms.append(transform);
+      }
+    }
+    int knotBatch = instances.addBatch(this, meshes[KnotMesh], transforms);
+    // Baked with the unlit scene program
+    const Mesh &knot = meshes[KnotMesh];
+    ShaderVariants::Variant &variant = shared->sceneShaders.get(
+        shared->programCache, knot.positionOnly ? scenePositionOnly : 0);
+    variant.program.bind();
+    shared->knotImpostor.bake(
+        this, knot, variant.location(SharedGeometry::ModelUniform),
+        variant.location(SharedGeometry::ViewUniform),
+        variant.location(SharedGeometry::ProjectionUniform));
+    variant.program.release();
+    instances.setImpostor(knotBatch, &shared->knotImpostor, 6.0f);
+
+    MemoryBudget &budget = shared->memoryBudget;
+    budget.add("instances", instances.getAllocatedBytes(), {}, {}, false);
+    budget.add("impostor atlas", shared->knotImpostor.getAllocatedBytes(), {},
+               {}, false);
+  }
+  instanceCuller.initialize(this, &instances);
+}
+
+/**
+ * @brief MainView::buildKnotTargets Creates the morph targets of the knot
+ * when it is first animated: an inflation along the directions from its
+ * center, and the sine and cosine halves of a wave travelling up the knot.
+ */
+void MainView::buildKnotTargets() {
+  Model knot(AssetWatcher::resolve(":/models/knot.obj"));
+  QVector<QVector3D> positions = knot.getMeshCoords();
+  knotDeformer.initialize(this, meshes[KnotMesh], positions);
+
+  const AABB &bounds = meshes[KnotMesh].bounds;
+  QVector3D center = bounds.center();
+  float amplitude = 0.08f * bounds.radius();
+  float waveNumber = 4.0f * float(M_PI) / (bounds.upper.y() - bounds.lower.y());
+
+  QVector<QVector3D> inflate;
+  QVector<QVector3D> waveSine;
+  QVector<QVector3D> waveCosine;
+  for (const QVector3D &p : positions) {
+    QVector3D direction = (p - center).normalized() * amplitude;
+    float phase = waveNumber * (p.y() - bounds.lower.y());
+    inflate.append(direction);
+    waveSine.append(std::sin(phase) * direction);
+    waveCosine.append(std::cos(phase) * direction);
+  }
+  knotDeformer.addTarget(inflate);
+  knotDeformer.addTarget(waveSine);
+  knotDeformer.addTarget(waveCosine);
+}
+
+/**
+ * @brief MainView::deformKnot Animates the knot for this frame and draws it
+ * from the streamed positions. The vertex pool and the software occluder keep
+ * the static knot, so vertex pulling shows it undeformed and it does not
+ * occlude while animated.
+ */
+void MainView::deformKnot() {
+  if (knotDeformer.isEmpty()) buildKnotTargets();
+  if (!morphClock.isValid()) morphClock.start();
+  float time = morphClock.elapsed() / 1000.0f;
+
+  // sin(kx - wt) = sin(kx) cos(wt) - cos(kx) sin(wt)
+  knotDeformer.setWeight(0, 0.5f + 0.5f * std::sin(1.7f * time));
+  knotDeformer.setWeight(1, std::cos(3.0f * time));
+  knotDeformer.setWeight(2, -std::sin(3.0f * time));
+  knotDeformer.update();
+
+  if (!staticKnot.vao) staticKnot = meshes[KnotMesh];
+  Mesh &mesh = meshes[KnotMesh];
+  mesh.vao = knotDeformer.getVertexArray();
+  mesh.positionVAO = mesh.vao;
+  mesh.bounds = knotDeformer.getBounds();
+  mesh.occluder = -1;
+  knotNode->setMesh(KnotMesh, mesh.bounds);
+}
+
+/**
+ * @brief MainView::enqueueModel Queues a model to be parsed and uploaded by
+ * the upload worker, which is started on first use.
+ * @param path Path of the model.
+ * @return Ticket of the upload.
+ */
+int MainView::enqueueModel(const QString &path) {
+  if (!uploadWorker) {
+    uploadWorker = new UploadWorker(context());
+    connect(uploadWorker, &UploadWorker::ready, this,
+            [this] { invalidate(SceneDirty); });
+  }
+
+  // The same buffer as addPositionMesh creates: models are knots, whose
+  // colors the shaders derive from the positions
+  return uploadWorker->enqueue([path] {
+    Model model(AssetWatcher::resolve(path));
+    QVector<QVector3D> coords = model.getMeshCoords();
+    QVector<VertexPosition> positions;
+    positions.reserve(coords.size());
+    for (const QVector3D &p : coords) positions.append({p.x(), p.y(), p.z()});
+
+    UploadWorker::Asset asset;
+    asset.buffers.append(
+        QByteArray(reinterpret_cast<const char *>(positions.constData()),
+                   positions.size() * sizeof(VertexPosition)));
+    asset.bounds = AABB::fromPoints(coords);
+    return asset;
+  });
 }
 
 /**
- * @brief MainView::fillArrayAndBuffer Fills VAO and VBO given the parameters
- * @param buf Initialized VBO
- * @param arr Initialized VAO
- * @param size Size of the Data
+ * @brief MainView::loadModelInBackground Loads another knot on the upload
+ * worker. Frames keep being drawn meanwhile; the knot appears once its
+ * buffers are complete.
+ */
+void MainView::loadModelInBackground() {
+  enqueueModel(streamedModel);
+}
+
+/**
+ * @brief MainView::addStreamedModels Adds the models whose upload completed
+ * to the scene, in a grid behind the objects.
+ */
+void MainView::addStreamedModels() {
+  for (const UploadWorker::Resource &resource : uploadWorker->takeFinished()) {
+    // An evicted or edited mesh that is back gets new buffers and vertex
+    // arrays; the buffers of an edited one are deleted first
+    if (reloads.contains(resource.ticket)) {
+      int meshIndex = reloads.take(resource.ticket);
+      if (meshIndex < shared->meshes.size()) {
+        replaceSharedMesh(meshIndex, resource);
+        continue;
+      }
+      Mesh &mesh = meshes[meshIndex];
+      glDeleteVertexArrays(1, &mesh.vao);
+      glDeleteVertexArrays(1, &mesh.positionVAO);
+      shared->memoryBudget.remove(this, mesh.resource);
+      mesh.vbo = mesh.positionVBO = resource.buffers[0];
+      mesh.count = resource.sizes[0] / sizeof(VertexPosition);
+      mesh.bounds = resource.bounds;
+      createVertexArrays(mesh);
+      shared->memoryBudget.restore(mesh.resource, resource.buffers);
+
+      QVector<SceneNode *> nodes;
+      scene.collectDrawables(nodes);
+      for (SceneNode *node : nodes) {
+        if (node->getMesh() == meshIndex) node->setMesh(meshIndex, mesh.bounds);
+      }
+      continue;
+    }
+
+    Mesh mesh;
+    mesh.vbo = mesh.positionVBO = resource.buffers[0];
+    mesh.positionOnly = true;
+    mesh.count = resource.sizes[0] / sizeof(VertexPosition);
+    mesh.bounds = resource.bounds;
+    mesh.resource = shared->memoryBudget.add(streamedModel, resource.sizes[0],
+                                             resource.buffers);
+    // Possibly evicted while another view draws, whose context is current
+    shared->memoryBudget.setEvictionHandler(mesh.resource, [this] {
+      QMetaObject::invokeMethod(this, [this] { releaseEvicted(); },
+                                Qt::QueuedConnection);
+    });
+    createVertexArrays(mesh);
+    meshes.append(mesh);
+
+    int slot = meshes.size() - 1 - shared->meshes.size();
+    SceneNode *node = scene.addChild(QString("streamed %1").arg(slot));
+    node->setMesh(meshes.size() - 1, mesh.bounds);
+    node->setTranslation(
+        QVector3D(-4.0f + 2.0f * (slot % 5), 2.0f, -10.0f - 2.0f * (slot / 5)));
+    node->setScale(0.5f);
+  }
+}
+
+/**
+ * @brief MainView::releaseEvicted Deletes the vertex arrays of the streamed
+ * meshes the memory budget evicted, which keep their buffers from being freed
+ * until then. addStreamedModels() creates new ones when a mesh is loaded
+ * again.
+ */
+void MainView::releaseEvicted() {
+  makeCurrent();
+  for (int i = shared->meshes.size(); i < meshes.size(); i++) {
+    Mesh &mesh = meshes[i];
+    if (!mesh.vao || shared->memoryBudget.isResident(mesh.resource)) continue;
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteVertexArrays(1, &mesh.positionVAO);
+    mesh.vao = mesh.positionVAO = 0;
+  }
+  doneCurrent();
+}
+
+/**
+ * @brief MainView::reloadAsset Reloads what was built from an asset that
+ * changed on disk. Programs and shared meshes are reloaded by the first view
+ * handling the change; every view reloads its own streamed meshes. Meshes are
+ * parsed and uploaded by the upload worker, and swapped in by
+ * addStreamedModels() between frames.
+ * @param resource Resource path of the asset.
+ * @param change Serial number of the change.
+ */
+void MainView::reloadAsset(const QString &resource, int change) {
+  bool first = change > shared->handledChange;
+  shared->handledChange = qMax(shared->handledChange, change);
+
+  if (resource.endsWith(".glsl")) {
+    makeCurrent();
+    if (first) reloadShaders(resource);
+    // A relinked program may have moved its uniforms
+    prepassModLoc = shared->prepassProgram.uniformLocation("modelTransform");
+    prepassViewLoc = shared->prepassProgram.uniformLocation("viewTransform");
+    prepassProjLoc =
+        shared->prepassProgram.uniformLocation("projectionTransform");
+    QOpenGLShaderProgram &depthView = shared->depthViewProgram;
+    depthViewNearLoc = depthView.uniformLocation("nearPlane");
+    depthViewFarLoc = depthView.uniformLocation("farPlane");
+    depthViewOrthoLoc = depthView.uniformLocation("orthographic");
+    doneCurrent();
+    invalidate(SceneDirty);
+    return;
+  }
+
+  const MemoryBudget &budget = shared->memoryBudget;
+  for (int i = 0; i < meshes.size(); i++) {
+    if (i < shared->meshes.size() && !first) continue;
+    int id = meshes[i].resource;
+    if (id >= 0 && budget.getSource(id) == resource && reloads.key(i, -1) < 0) {
+      reloads.insert(enqueueModel(resource), i);
+    }
+  }
+}
+
+/**
+ * @brief MainView::reloadShaders Rebuilds the shared programs that use a
+ * changed shader, leaving all others alone.
+ * @param resource Resource path of the shader.
+ */
+void MainView::reloadShaders(const QString &resource) {
+  ProgramCache &cache = shared->programCache;
+  shared->sceneShaders.reload(cache, resource);
+  shared->pullShaders.reload(cache, resource);
+  shared->instances.reloadShaders(resource);
+  for (const ProgramSources &sources : programSources) {
+    if (sources.vertex == resource || sources.fragment == resource) {
+      cache.rebuild(shared->*sources.program, sources.stages());
+    }
+  }
+}
+
+/**
+ * @brief MainView::replaceSharedMesh Swaps the vertices of a shared mesh for
+ * those of its edited model, uploaded by the worker. They are copied into the
+ * existing buffers, which the vertex arrays of every view refer to, so the
+ * views only take over the new count, bounds and levels of detail.
+ * @param meshIndex Index of the mesh in the shared meshes.
+ * @param resource Buffers uploaded by the worker, deleted afterwards.
+ */
+void MainView::replaceSharedMesh(int meshIndex,
+                                 const UploadWorker::Resource &resource) {
+  // Shared meshes from models store positions only, like the streamed ones
+  Mesh &mesh = shared->meshes[meshIndex];
+  glBindBuffer(GL_COPY_READ_BUFFER, resource.buffers[0]);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, mesh.positionVBO);
+  glBufferData(GL_COPY_WRITE_BUFFER, resource.sizes[0], nullptr, GL_STATIC_DRAW);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                      resource.sizes[0]);
+  mesh.count = resource.sizes[0] / sizeof(VertexPosition);
+  mesh.bounds = resource.bounds;
+
+  // The worker waited for the upload, so reading the positions back for the
+  // levels of detail and the occluder does not stall
+  QVector<VertexPosition> positions(mesh.count);
+  glGetBufferSubData(GL_COPY_READ_BUFFER, 0, resource.sizes[0], positions.data());
+  glDeleteBuffers(resource.buffers.size(), resource.buffers.constData());
+  QVector<QVector3D> coords;
+  for (const VertexPosition &p : positions) coords.append(QVector3D(p.x, p.y, p.z));
+  if (!mesh.lods.isEmpty()) buildLods(meshIndex, coords);
+  if (shared->occluderCoords.contains(meshIndex)) {
+    QVector<unsigned> indices;
+    for (int i = 0; i < mesh.count; i++) indices.append(i);
+    shared->occluderCoords[meshIndex] = coords;
+    shared->occluderIndices[meshIndex] = indices;
+  }
+
+  shared->vertexPool.destroy(this);
+  shared->vertexPool.build(this, shared->meshes);
+  shared->memoryBudget.resize(shared->poolResource,
+                              shared->vertexPool.getAllocatedBytes());
+  shared->meshGeneration++;
+  shared->assetWatcher->notifyReloaded();
+}
+
+/**
+ * @brief MainView::refreshSharedMeshes Takes over the shared meshes after one
+ * was reloaded, keeping the vertex arrays of this view, and updates what was
+ * derived from their old vertices. The deformed knot starts over from the new
+ * ones; the impostors of the instance field keep the old knot.
+ */
+void MainView::refreshSharedMeshes() {
+  meshGeneration = shared->meshGeneration;
+  if (staticKnot.vao) {
+    meshes[KnotMesh] = staticKnot;
+    staticKnot = Mesh();
+  }
+  knotDeformer.destroy();
+
+  for (int i = 0; i < shared->meshes.size(); i++) {
+    const Mesh &source = shared->meshes[i];
+    Mesh &mesh = meshes[i];
+    mesh.count = source.count;
+    mesh.bounds = source.bounds;
+    mesh.lods = source.lods;
+    if (mesh.occluder >= 0) {
+      softwareOccluder.setOccluder(mesh.occluder, shared->occluderCoords[i],
+                                   shared->occluderIndices[i]);
+    }
+    shared->instances.updateMesh(mesh);
+  }
+
+  QVector<SceneNode *> nodes;
+  scene.collectDrawables(nodes);
+  for (SceneNode *node : nodes) {
+    int meshIndex = node->getMesh();
+    if (meshIndex < shared->meshes.size()) {
+      node->setMesh(meshIndex, meshes[meshIndex].bounds);
+    }
+  }
+}
+
+/**
+ * @brief MainView::keepResident Marks the meshes of the drawables in view as
+ * used in the memory budget. Evicted meshes are left out of the frame; those
+ * in view are loaded again.
+ * @param drawables Nodes to be drawn this frame, without the evicted ones
+ * afterwards.
+ */
+void MainView::keepResident(QVector<SceneNode *> &drawables) {
+  MemoryBudget &budget = shared->memoryBudget;
+  Frustum frustum = Frustum::fromMatrix(projection * view);
+  QVector<SceneNode *> resident;
+  for (SceneNode *node : drawables) {
+    int meshIndex = node->getMesh();
+    const Mesh &mesh = meshes[meshIndex];
+    if (mesh.resource < 0) {
+      resident.append(node);
+    } else if (!frustum.intersects(node->worldBounds())) {
+      // Out of view: drawn or casting a shadow if resident, but not used
+      if (budget.isResident(mesh.resource)) resident.append(node);
+    } else if (budget.use(mesh.resource)) {
+      resident.append(node);
+    } else if (reloads.key(meshIndex, -1) < 0) {
+      reloads.insert(enqueueModel(budget.getSource(mesh.resource)), meshIndex);
+    }
+  }
+  drawables = resident;
+}
+
+/**
+ * @brief MainView::addMesh Uploads a vertex array into new shared buffers.
+ * @param size Number of vertices
  * @param vertices Array of vertices
+ * @return Index of the new mesh in the shared meshes
  */
-void MainView::fillArrayAndBuffer(GLuint buf, GLuint arr, int size, Vertex *vertices) {
-  glBindVertexArray(arr);
-  glBindBuffer(GL_ARRAY_BUFFER, buf);
+int MainView::addMesh(int size, Vertex *vertices) {
+  Mesh mesh;
+  mesh.count = size;
+  for (int i = 0; i < size; i++) {
+    mesh.bounds.expand(QVector3D(vertices[i].x, vertices[i].y, vertices[i].z));
+  }
+
+  glGenBuffers(1, &mesh.vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*size, vertices, GL_STATIC_DRAW);
+
+  // Separate position-only stream, so the depth pre-pass fetches no colors
+  QVector<GLfloat> positions;
+  positions.reserve(3 * size);
+  for (int i = 0; i < size; i++) {
+    positions.append(vertices[i].x);
+    positions.append(vertices[i].y);
+    positions.append(vertices[i].z);
+  }
+  glGenBuffers(1, &mesh.positionVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.positionVBO);
+  glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat),
+               positions.constData(), GL_STATIC_DRAW);
+
+  shared->meshes.append(mesh);
+  return shared->meshes.size() - 1;
+}
+
+/**
+ * @brief MainView::addPositionMesh Uploads the positions of a mesh whose
+ * colors the shaders derive, into one new shared buffer serving as both its
+ * vertex and position stream.
+ * @param positions Positions of the vertices.
+ * @return Index of the new mesh in the shared meshes
+ */
+int MainView::addPositionMesh(const QVector<QVector3D> &positions) {
+  Mesh mesh;
+  mesh.count = positions.size();
+  mesh.bounds = AABB::fromPoints(positions);
+  mesh.positionOnly = true;
+
+  QVector<VertexPosition> vertices;
+  vertices.reserve(positions.size());
+  for (const QVector3D &p : positions) vertices.append({p.x(), p.y(), p.z()});
+  glGenBuffers(1, &mesh.positionVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.positionVBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexPosition),
+               vertices.constData(), GL_STATIC_DRAW);
+  mesh.vbo = mesh.positionVBO;
+
+  shared->meshes.append(mesh);
+  return shared->meshes.size() - 1;
+}
+
+/**
+ * @brief MainView::createVertexArrays Creates the vertex arrays of this view
+ * for the shared buffers of a mesh.
+ * @param mesh Copy of a shared mesh, receives the vertex arrays.
+ */
+void MainView::createVertexArrays(Mesh &mesh) {
+  glGenVertexArrays(1, &mesh.vao);
+  glBindVertexArray(mesh.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+  if (mesh.positionOnly) {
+    positionFormat.specify(this);
+  } else {
+    specifyDataLayout();
+  }
+  if (mesh.ebo) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+
+  glGenVertexArrays(1, &mesh.positionVAO);
+  glBindVertexArray(mesh.positionVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.positionVBO);
+  positionFormat.specify(this);
+  if (mesh.ebo) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+  glBindVertexArray(0);
+}
+
+/**
+ * @brief MainView::buildLods Generates levels of detail of decreasing detail
+ * for a mesh by vertex clustering, and stores all of them in one element
+ * buffer that shares the mesh's vertices.
+ * @param meshIndex Index of the mesh in the shared meshes
+ * @param positions Positions of the vertices the mesh was created from
+ */
+void MainView::buildLods(int meshIndex, const QVector<QVector3D> &positions) {
+  Mesh &mesh = shared->meshes[meshIndex];
+  float radius = mesh.bounds.radius();
+
+  QVector<unsigned> indices;
+  for (int i = 0; i < mesh.count; i++) indices.append(i);
+
+  // Level 0 is the full mesh, coarser levels double the cluster size, and are
+  // kept only if they remove a meaningful share of the triangles
+  QVector<unsigned> elements = indices;
+  mesh.lods.clear();
+  mesh.lods.append({0, mesh.count, 0.0f});
+  for (float fraction = 1.0f / 32.0f; fraction <= 0.5f; fraction *= 2.0f) {
+    QVector<unsigned> level = clusterIndices(positions, indices, radius * fraction);
+    if (level.isEmpty()) break;
+    if (level.size() > mesh.lods.last().count * 3 / 4) continue;
+    mesh.lods.append({static_cast<GLuint>(elements.size()),
+                      static_cast<GLsizei>(level.size()), fraction});
+    elements.append(level);
+  }
+
+  // Uploaded through the array buffer binding, as element buffer bindings
+  // belong to the vertex arrays of each view. A reloaded mesh keeps its
+  // buffer, which those vertex arrays refer to
+  if (!mesh.ebo) glGenBuffers(1, &mesh.ebo);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.ebo);
+  glBufferData(GL_ARRAY_BUFFER, elements.size() * sizeof(GLuint),
+               elements.constData(), GL_STATIC_DRAW);
+
+  qDebug() << ":: Built" << mesh.lods.size() << "levels of detail";
 }
 
 /**
@@ -138,16 +812,38 @@ void MainView::fillArrayAndBuffer(GLuint buf, GLuint arr, int size, Vertex *vert
  * vertex and fragment shader.
  */
 void MainView::createShaderProgram() {
-  shaderProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
-                                        ":/shaders/vertshader.glsl");
-  shaderProgram.addShaderFromSourceFile(QOpenGLShader::Fragment,
-                                        ":/shaders/fragshader.glsl");
-  shaderProgram.link();
+  // Compiled by the first view of the window only
+  if (!shared->prepassProgram.isLinked()) {
+    QElapsedTimer buildTimer;
+    buildTimer.start();
+
+    // The programs shading the scene are built per variant when first used;
+    // the unlit one is needed for the first frame
+    ProgramCache &cache = shared->programCache;
+    shared->sceneShaders.get(cache, 0);
+    for (const ProgramSources &sources : programSources) {
+      cache.build(shared->*sources.program, sources.stages());
+    }
+
+    qDebug() << ":: Built programs in" << buildTimer.elapsed() << "ms,"
+             << cache.getHits() << "from the cache";
+  }
 
   // Extracting locations of the uniforms
-  // check and see if the values returned here are correct -- they are correct
-  modLoc = shaderProgram.uniformLocation("modelTransform");
-  projLoc = shaderProgram.uniformLocation("projectionTransform");
+  prepassModLoc = shared->prepassProgram.uniformLocation("modelTransform");
+  prepassViewLoc = shared->prepassProgram.uniformLocation("viewTransform");
+  prepassProjLoc = shared->prepassProgram.uniformLocation("projectionTransform");
+  QOpenGLShaderProgram &depthView = shared->depthViewProgram;
+  depthViewNearLoc = depthView.uniformLocation("nearPlane");
+  depthViewFarLoc = depthView.uniformLocation("farPlane");
+  depthViewOrthoLoc = depthView.uniformLocation("orthographic");
+
+  const ShaderVariants &scene = shared->sceneShaders;
+  sceneLighting = scene.featureBit("LIGHTING");
+  sceneShadows = scene.featureBit("SHADOWS");
+  scenePositionOnly = scene.featureBit("POSITION_ONLY");
+  pullLighting = shared->pullShaders.featureBit("LIGHTING");
+  pullShadows = shared->pullShaders.featureBit("SHADOWS");
 }
 
 /**
@@ -155,27 +851,514 @@ void MainView::createShaderProgram() {
  *
  */
 void MainView::paintGL() {
-  // Clear the screen before rendering
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  shaderProgram.bind();
+  // Nothing changed since the last frame, which the framebuffer still holds;
+  // this is the case for expose events and repaints of the window system
+  bool animating = continuousRendering || showParticles || morphing;
+  if (!dirty && settleFrames == 0 && !animating) return;
+
+  // After a change, a few more frames are drawn: occlusion culling follows
+  // the visibility of the previous frame, and the last frame before going
+  // idle is drawn at full resolution
+  if (dirty) settleFrames = settleFrameCount;
+  dirty = 0;
+  if (settleFrames > 0) settleFrames--;
+  finalFrame = settleFrames == 0 && !animating;
+  resolutionController.setEnabled(dynamicResolution && !finalFrame);
+
+  // The instance field and the particles are only created by views that show
+  // them
+  if (showInstances && instanceCuller.isEmpty()) buildInstanceField();
+  if (showParticles && !particleVAOs[0]) {
+    if (shared->particles.getCount() == 0) {
+      shared->particles.initialize(this, particleCount);
+      shared->memoryBudget.add("particles",
+                               shared->particles.getAllocatedBytes(), {}, {},
+                               false);
+    }
+    shared->particles.createVertexArrays(this, particleVAOs);
+  }
+
+  resolutionController.beginFrame();
+  shared->beginFrame(this, this);
+
+  if (uploadWorker) addStreamedModels();
+  if (meshGeneration != shared->meshGeneration) refreshSharedMeshes();
+
+  if (morphing) {
+    deformKnot();
+  } else if (staticKnot.vao) {
+    meshes[KnotMesh] = staticKnot;
+    staticKnot = Mesh();
+    knotNode->setMesh(KnotMesh, meshes[KnotMesh].bounds);
+  }
+
+  // Drawing every node in the scene graph that carries a mesh
+  QVector<SceneNode *> drawables;
+  scene.collectDrawables(drawables);
+  keepResident(drawables);
+
+  // Every drawable may cast a shadow, including the culled ones
+  QVector<SceneNode *> casters = drawables;
+
+  if (softwareCulling) cullWithSoftwareOccluder(drawables);
+  selectLods(drawables);
+
+  buildFrameGraph(drawables, casters);
+  frameGraph.compile();
+  frameGraph.execute();
+  if (morphing) knotDeformer.fence();
+
+  // Targets are created on the first frame at a size, instance buffers when
+  // the field changes
+  MemoryBudget &budget = shared->memoryBudget;
+  budget.resize(targetResource, frameGraph.getAllocatedBytes());
+  budget.resize(cullResource, instanceCuller.getAllocatedBytes());
+
+  resolutionController.endFrame();
+
+  // Animations keep moving, so the next frame is requested right away
+  if (settleFrames > 0 || showParticles || morphing) update();
+}
+
+/**
+ * @brief MainView::buildFrameGraph Declares the passes of this frame and the
+ * targets they read and write. Passes whose results are not used, such as the
+ * shadow maps without lighting, are culled by the graph.
+ * @param drawables Nodes to be drawn this frame.
+ * @param casters Nodes that may cast shadows.
+ */
+void MainView::buildFrameGraph(const QVector<SceneNode *> &drawables,
+                               const QVector<SceneNode *> &casters) {
+  using Resource = RenderGraph::Resource;
+  frameGraph.reset();
+
+  Resource screen;
+  Resource screenDepth;
+  frameGraph.importFramebuffer("widget", defaultFramebufferObject(),
+                               viewportWidth, viewportHeight, screen,
+                               screenDepth);
 
-  // Setting value of each uniform for pyramid
-  glUniformMatrix4fv(modLoc, 1, GL_FALSE, model.data());
-  glUniformMatrix4fv(projLoc, 1, GL_FALSE, projection.data());
+  // With post-processing or a reduced resolution, the scene is drawn to
+  // transient targets instead of the widget
+  float scale = resolutionController.getScale();
+  int sceneWidth = qMax(qRound(viewportWidth * scale), 1);
+  int sceneHeight = qMax(qRound(viewportHeight * scale), 1);
+  bool scaled = sceneWidth != viewportWidth || sceneHeight != viewportHeight;
 
-  // Draw here
-  glBindVertexArray(array);
-  glDrawArrays(GL_TRIANGLES, 0, 18);
+  Resource color = screen;
+  Resource depth = screenDepth;
+  if (postProcessing || scaled) {
+    color = frameGraph.createTexture(
+        "scene color",
+        {sceneWidth, sceneHeight, postProcessing ? GL_RGBA16F : GL_RGBA8});
+    depth = frameGraph.createTexture(
+        "scene depth", {sceneWidth, sceneHeight, GL_DEPTH_COMPONENT24});
+  }
+
+  // The shadow maps keep their contents between frames, and only re-render
+  // what changed
+  Resource shadowTextures[2];
+  int shadowPass = frameGraph.addPass(
+      "shadows", [this, casters] { updateShadowMaps(casters); });
+  for (int i = 0; i < 2; i++) {
+    Resource shadowTexture = frameGraph.importTexture(
+        QString("shadow map %1").arg(i),
+        shadowMaps[i].getDepthTexture(), shadowFramebuffers[i],
+        ShadowMap::size, ShadowMap::size);
+    shadowTextures[i] = frameGraph.write(shadowPass, shadowTexture);
+  }
+
+  // Laying down the final depth first; with GL_LEQUAL, only the nearest
+  // fragment of every pixel is shaded afterwards
+  if (depthPrepass) {
+    int pass = frameGraph.addPass(
+        "depth pre-pass", [this, drawables] { drawDepthPrepass(drawables); });
+    depth = frameGraph.write(pass, depth, RenderGraph::Clear);
+  }
+
+  int scenePass =
+      frameGraph.addPass("scene", [this, drawables] { drawScene(drawables); });
+  if (clusteredLighting && shadows) {
+    for (Resource shadowTexture : shadowTextures) {
+      frameGraph.read(scenePass, shadowTexture);
+    }
+  }
+  color = frameGraph.write(scenePass, color, RenderGraph::Clear);
+  depth = frameGraph.write(scenePass, depth,
+                           depthPrepass ? RenderGraph::Load : RenderGraph::Clear);
+
+  if (showInstances) {
+    int pass = frameGraph.addPass("instances", [this] {
+      instanceCuller.cull(projection, view, finalFrame);
+      instanceCuller.draw(projection, view, finalFrame);
+    });
+    color = frameGraph.write(pass, color);
+    depth = frameGraph.write(pass, depth);
+  }
+
+  // Simulated by the first view drawing them in a frame of the group, and
+  // drawn in the same pass, after the opaque geometry they are depth tested
+  // against
+  if (showParticles) {
+    int pass = frameGraph.addPass("particles", [this, sceneHeight] {
+      ParticleSystem &particles = shared->particles;
+      particles.update(this, particleVAOs, shared->getFrame());
+      particles.draw(this, particleVAOs, projection, view,
+                     particleSize * 0.5f * projection(1, 1) * sceneHeight);
+    });
+    color = frameGraph.write(pass, color);
+    depth = frameGraph.write(pass, depth);
+  }
+
+  // The post chain upscales in its last stage
+  if (postProcessing) {
+    screen = postChain.addPasses(frameGraph, color, depth, screen);
+  } else if (scaled) {
+    int pass = frameGraph.addPass("upscale", [this, color] {
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, frameGraph.getTexture(color));
+      glDisable(GL_DEPTH_TEST);
+      shared->upscaleProgram.bind();
+      glBindVertexArray(emptyVAO);
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+      shared->upscaleProgram.release();
+      glEnable(GL_DEPTH_TEST);
+    });
+    frameGraph.read(pass, color);
+    screen = frameGraph.write(pass, screen, RenderGraph::DontCare);
+  } else {
+    screen = color;
+  }
+
+  if (showOccluderDepth) {
+    int pass = frameGraph.addPass("occluder depth", [this] { drawOccluderDepth(); });
+    frameGraph.write(pass, screen);
+  }
+}
+
+/**
+ * @brief MainView::drawScene Shades the drawables with the lit or unlit
+ * program, optionally with hardware occlusion culling.
+ * @param drawables Nodes to be drawn this frame.
+ */
+void MainView::drawScene(const QVector<SceneNode *> &drawables) {
+  // The depth pre-pass already wrote the final depth
+  if (depthPrepass) glDepthMask(GL_FALSE);
 
-  // setting value of each uniform for knot
-  glUniformMatrix4fv(modLoc, 1, GL_FALSE, knotModel.data());
-  glUniformMatrix4fv(projLoc, 1, GL_FALSE, projection.data());
+  // The variant with only the enabled features compiled in
+  quint32 sceneMask = 0;
+  quint32 pullMask = 0;
+  if (clusteredLighting) {
+    sceneMask |= sceneLighting;
+    pullMask |= pullLighting;
+  }
+  if (clusteredLighting && shadows) {
+    sceneMask |= sceneShadows;
+    pullMask |= pullShadows;
+  }
+  if (clusteredLighting) {
+    QVector<PointLight> viewLights = lights;
+    for (PointLight &light : viewLights) light.position = view.map(light.position);
+    shared->lightClusters.assign(this, viewLights, projection, nearPlane,
+                                 farPlane);
+    shared->memoryBudget.resize(shared->clusterResource,
+                                shared->lightClusters.getAllocatedBytes());
+    shared->lightClusters.bind(this, GL_TEXTURE1);
+  }
 
-  // Draw here
-  glBindVertexArray(knotVAO);
-  glDrawArrays(GL_TRIANGLES, 0, 3840);
+  QVector<SceneNode *> nodes = drawables;
+  if (vertexPulling) {
+    // The nodes in the vertex pool in one draw without vertex arrays; as
+    // occlusion culling needs a draw per node, it does not apply to them. The
+    // others are drawn from their vertex arrays below, as in the pre-pass
+    QVector<SceneNode *> pulled;
+    nodes.clear();
+    for (SceneNode *node : drawables) {
+      (isPulled(node) ? pulled : nodes).append(node);
+    }
+    ShaderVariants::Variant &variant =
+        shared->pullShaders.get(shared->programCache, pullMask);
+    variant.program.bind();
+    glUniformMatrix4fv(variant.location(SharedGeometry::ProjectionUniform), 1,
+                       GL_FALSE, projection.data());
+    glUniformMatrix4fv(variant.location(SharedGeometry::ViewUniform), 1,
+                       GL_FALSE, view.constData());
+    if (clusteredLighting) setLightingUniforms(variant);
+    vertexPuller.draw(variant.program, shared->vertexPool, meshes, pulled);
+    variant.program.release();
+    if (nodes.isEmpty()) {
+      glDepthMask(GL_TRUE);
+      return;
+    }
+  }
+
+  // Position-only meshes are drawn with the variant deriving their colors;
+  // drawNode() switches between the variants the nodes need
+  bool needed[2] = {nodes.isEmpty(), false};
+  for (SceneNode *node : nodes) {
+    needed[meshes[node->getMesh()].positionOnly] = true;
+  }
+  for (int positionOnly = 0; positionOnly < 2; positionOnly++) {
+    if (!needed[positionOnly]) continue;
+    quint32 mask = sceneMask | (positionOnly ? scenePositionOnly : 0);
+    ShaderVariants::Variant &variant =
+        shared->sceneShaders.get(shared->programCache, mask);
+    variant.program.bind();
+    glUniformMatrix4fv(variant.location(SharedGeometry::ProjectionUniform), 1,
+                       GL_FALSE, projection.data());
+    glUniformMatrix4fv(variant.location(SharedGeometry::ViewUniform), 1,
+                       GL_FALSE, view.constData());
+    if (clusteredLighting) setLightingUniforms(variant);
+    sceneVariants[positionOnly] = &variant;
+    boundVariant = &variant;
+  }
 
-  shaderProgram.release();
+  if (occlusionCulling) {
+    // Last frame's visible meshes first, so they occlude the queried boxes
+    QVector<SceneNode *> visible;
+    QVector<SceneNode *> deferred;
+    occlusionCuller.beginFrame(nodes, meshes, visible, deferred);
+    for (SceneNode *node : visible) drawNode(node);
+
+    occlusionCuller.issueQueries(
+        boundVariant->location(SharedGeometry::ModelUniform), view, nearPlane);
+    for (SceneNode *node : deferred) {
+      occlusionCuller.beginConditional(node);
+      drawNode(node);
+      occlusionCuller.endConditional(node);
+    }
+  } else {
+    for (SceneNode *node : nodes) drawNode(node);
+  }
+
+  boundVariant->program.release();
+  boundVariant = nullptr;
+  glDepthMask(GL_TRUE);
+}
+
+/**
+ * @brief MainView::isPulled Returns whether vertex pulling draws a node. Meshes
+ * added after the vertex pool was built, such as streamed models, are not in
+ * the pool, and the pool holds the static knot only, not the deformed one.
+ * @param node A drawable node.
+ * @return Whether the node is drawn from the vertex pool.
+ */
+bool MainView::isPulled(const SceneNode *node) const {
+  int meshIndex = node->getMesh();
+  if (meshIndex == KnotMesh && staticKnot.vao) return false;
+  return shared->vertexPool.contains(meshIndex);
+}
+
+/**
+ * @brief MainView::updatePostEffects Sets the post-processing effects; the
+ * per-pixel ones are fused into a single pass unless sharpening separates them.
+ */
+void MainView::updatePostEffects() {
+  QVector<PostChain::Effect> effects = {PostChain::AmbientOcclusion,
+                                        PostChain::Tonemap};
+  if (sharpening) effects.append(PostChain::Sharpen);
+  effects.append(PostChain::ColorGrade);
+  effects.append(PostChain::Vignette);
+  postChain.setEffects(effects);
+}
+
+/**
+ * @brief MainView::drawNode Draws the mesh of a node with its world
+ * transformation, binding the variant of this frame for its mesh.
+ * @param node The node to draw.
+ */
+void MainView::drawNode(SceneNode *node) {
+  const Mesh &mesh = meshes[node->getMesh()];
+  ShaderVariants::Variant *variant = sceneVariants[mesh.positionOnly];
+  if (variant != boundVariant) {
+    variant->program.bind();
+    boundVariant = variant;
+  }
+  glUniformMatrix4fv(variant->location(SharedGeometry::ModelUniform), 1,
+                     GL_FALSE, node->worldTransform().data());
+  glBindVertexArray(mesh.vao);
+  drawMesh(mesh, node->getLod());
+}
+
+/**
+ * @brief MainView::setLightingUniforms Sets up a variant with lighting, and
+ * shadows if enabled, from the light clusters of this frame.
+ * @param variant The lit variant, expected to be bound.
+ */
+void MainView::setLightingUniforms(ShaderVariants::Variant &variant) {
+  using Uniform = SharedGeometry::SceneUniform;
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  glUniform1i(variant.location(Uniform::LightDataUniform), 1);
+  glUniform1i(variant.location(Uniform::LightIndicesUniform), 2);
+  glUniform1i(variant.location(Uniform::ClusterGridUniform), 3);
+  glUniform3i(variant.location(Uniform::GridSizeUniform), LightClusters::gridX,
+              LightClusters::gridY, LightClusters::gridZ);
+  glUniform2f(variant.location(Uniform::ViewportSizeUniform), viewport[2],
+              viewport[3]);
+  glUniform1f(variant.location(Uniform::NearPlaneUniform), nearPlane);
+  glUniform1f(variant.location(Uniform::FarPlaneUniform), farPlane);
+  if (!shadows) return;
+
+  // Shadow maps on the units after the light clusters; the shader works in
+  // view space, the shadow transformations start from world space
+  QMatrix4x4 inverseView = view.inverted();
+  for (int i = 0; i < SharedGeometry::maxShadowLights; i++) {
+    const ShadowMap &shadowMap = shadowMaps[i];
+    const ShadowLight &light = shadowMap.getLight();
+    QVector3D position = view.map(light.position);
+    QVector3D direction = view.mapVector(light.direction).normalized();
+    QMatrix4x4 shadowTransform = shadowMap.getShadowTransform() * inverseView;
+    float cosAngle = light.type == ShadowLight::Spot
+                         ? cos(qDegreesToRadians(light.angle))
+                         : -2.0f;
+
+    glUniformMatrix4fv(variant.location(Uniform::ShadowTransformUniforms + i), 1,
+                       GL_FALSE, shadowTransform.constData());
+    glUniform3f(variant.location(Uniform::ShadowLightPositionUniforms + i),
+                position.x(), position.y(), position.z());
+    glUniform3f(variant.location(Uniform::ShadowLightDirectionUniforms + i),
+                direction.x(), direction.y(), direction.z());
+    glUniform1f(variant.location(Uniform::ShadowLightCosAngleUniforms + i),
+                cosAngle);
+    glUniform3f(variant.location(Uniform::ShadowLightColorUniforms + i),
+                light.color.x(), light.color.y(), light.color.z());
+
+    glActiveTexture(GL_TEXTURE4 + i);
+    glBindTexture(GL_TEXTURE_2D, shadowMap.getDepthTexture());
+    glUniform1i(variant.location(Uniform::ShadowMapUniforms + i), 4 + i);
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
+
+/**
+ * @brief MainView::updateShadowMaps Re-renders the shadow maps whose casters or
+ * light changed since they were last rendered; the others are reused as is.
+ * @param casters Nodes that may cast shadows.
+ */
+void MainView::updateShadowMaps(const QVector<SceneNode *> &casters) {
+  // The projections of the lights start from world space
+  shared->prepassProgram.bind();
+  glUniformMatrix4fv(prepassViewLoc, 1, GL_FALSE, QMatrix4x4().constData());
+  for (int i = 0; i < 2; i++) {
+    shadowMaps[i].update(this, shadowFramebuffers[i], casters, meshes,
+                                 prepassModLoc, prepassProjLoc);
+  }
+  shared->prepassProgram.release();
+}
+
+/**
+ * @brief MainView::drawMesh Issues the draw call of a mesh at a level of
+ * detail. Expects one of the mesh's VAOs to be bound.
+ * @param mesh The mesh.
+ * @param lod The level of detail, ignored if the mesh has no levels.
+ */
+void MainView::drawMesh(const Mesh &mesh, int lod) {
+  if (mesh.lods.isEmpty()) {
+    glDrawArrays(GL_TRIANGLES, 0, mesh.count);
+    return;
+  }
+  const LodLevel &level = mesh.lods[lod];
+  glDrawElements(GL_TRIANGLES, level.count, GL_UNSIGNED_INT,
+                 (void *)(level.first * sizeof(GLuint)));
+}
+
+/**
+ * @brief MainView::selectLods Picks the level of detail of every drawable for
+ * this frame, from the size of its bounding sphere on screen.
+ * @param drawables Nodes to be drawn this frame.
+ */
+void MainView::selectLods(const QVector<SceneNode *> &drawables) {
+  for (SceneNode *node : drawables) {
+    const Mesh &mesh = meshes[node->getMesh()];
+    if (mesh.lods.isEmpty()) continue;
+    if (!lodSelection) {
+      node->setLod(0);
+      continue;
+    }
+
+    // Perspective views shrink the radius with the distance from the eye, at
+    // the origin of view space; orthographic views keep it at any distance
+    const AABB &bounds = node->worldBounds();
+    float radius = bounds.radius();
+    float projectedRadius = radius * focalLength;
+    if (camera == Perspective) {
+      float distance = view.map(bounds.center()).length();
+      projectedRadius = distance > radius ? projectedRadius / distance : FLT_MAX;
+    }
+    node->setLod(selectLod(mesh.lods, node->getLod(), projectedRadius,
+                           lodTolerance));
+  }
+}
+
+/**
+ * @brief MainView::drawDepthPrepass Draws the depth of the drawables with a
+ * position-only program.
+ * @param drawables Nodes to be drawn this frame.
+ */
+void MainView::drawDepthPrepass(const QVector<SceneNode *> &drawables) {
+  shared->prepassProgram.bind();
+  glUniformMatrix4fv(prepassProjLoc, 1, GL_FALSE, projection.data());
+  glUniformMatrix4fv(prepassViewLoc, 1, GL_FALSE, view.constData());
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+  for (SceneNode *node : drawables) {
+    const Mesh &mesh = meshes[node->getMesh()];
+    glUniformMatrix4fv(prepassModLoc, 1, GL_FALSE, node->worldTransform().data());
+    glBindVertexArray(mesh.positionVAO);
+    drawMesh(mesh, node->getLod());
+  }
+
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  shared->prepassProgram.release();
+}
+
+/**
+ * @brief MainView::cullWithSoftwareOccluder Rasterizes the occluders among the
+ * drawables on the CPU and removes the drawables hidden behind them.
+ * @param drawables Nodes to be drawn this frame, filtered in place.
+ */
+void MainView::cullWithSoftwareOccluder(QVector<SceneNode *> &drawables) {
+  softwareOccluder.beginFrame(projection * view);
+  for (SceneNode *node : drawables) {
+    int occluder = meshes[node->getMesh()].occluder;
+    if (occluder >= 0) softwareOccluder.addInstance(occluder, node->worldTransform());
+  }
+  softwareOccluder.rasterize();
+
+  QVector<SceneNode *> visible;
+  for (SceneNode *node : drawables) {
+    if (softwareOccluder.isVisible(node->worldBounds())) visible.append(node);
+  }
+  drawables = visible;
+}
+
+/**
+ * @brief MainView::drawOccluderDepth Shows the depth buffer of the software
+ * occluder in the bottom left corner of the view.
+ */
+void MainView::drawOccluderDepth() {
+  glBindTexture(GL_TEXTURE_2D, occluderDepthTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SoftwareOccluder::width,
+                  SoftwareOccluder::height, GL_RED, GL_FLOAT,
+                  softwareOccluder.depthData());
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glViewport(viewport[0], viewport[1], viewport[2] / 3, viewport[3] / 3);
+  glDisable(GL_DEPTH_TEST);
+
+  shared->depthViewProgram.bind();
+  glUniform1f(depthViewNearLoc, nearPlane);
+  glUniform1f(depthViewFarLoc, farPlane);
+  glUniform1i(depthViewOrthoLoc, camera != Perspective);
+  glBindVertexArray(emptyVAO);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  shared->depthViewProgram.release();
+
+  glEnable(GL_DEPTH_TEST);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 }
 
 /**
@@ -186,34 +1369,75 @@ void MainView::paintGL() {
  */
 void MainView::resizeGL(int newWidth, int newHeight) {
   // updating projection to fit new aspect ratio
+  float aspect = (float)newWidth/(float)newHeight;
   projection.setToIdentity();
-  projection.perspective(60.0, ((float)newWidth/(float)newHeight), 0.2, 20.0);
+  view.setToIdentity();
+  if (camera == Perspective) {
+    nearPlane = 0.2f;
+    farPlane = 20.0f;
+    projection.perspective(60.0, aspect, nearPlane, farPlane);
+  } else {
+    // The orthographic views look at the middle of the scene
+    QVector3D center(0, -1, -6);
+    QVector3D offset = camera == Top     ? QVector3D(0, 10, 0)
+                       : camera == Front ? QVector3D(0, 0, 10)
+                                         : QVector3D(10, 0, 0);
+    QVector3D up = camera == Top ? QVector3D(0, 0, -1) : QVector3D(0, 1, 0);
+    nearPlane = 0.2f;
+    farPlane = 30.0f;
+    projection.ortho(-7.0f * aspect, 7.0f * aspect, -7.0f, 7.0f, nearPlane, farPlane);
+    view.lookAt(center + offset, center, up);
+  }
+  dirty |= CameraDirty | ViewportDirty;
+
+  viewportWidth = qRound(newWidth * devicePixelRatioF());
+  viewportHeight = qRound(newHeight * devicePixelRatioF());
+  resolutionController.setDevicePixelRatio(devicePixelRatioF());
+  postChain.setProjection(projection);
+
+  // Pixels covered by one unit at unit distance, for the level of detail; at
+  // any distance for the orthographic views
+  focalLength = 0.5f * projection(1, 1) * newHeight * devicePixelRatioF();
 }
 
 /**
  * @brief MainView::rotationAndScaling Combines scaling and rotation operations in one function
  */
 void MainView::rotateAndScale() {
-  // making sure the model is centered on the given coordinates
-  model.setToIdentity();
-  knotModel.setToIdentity();
-  model.translate(-2, 0, -6);
-  knotModel.translate(2, 0, -6);
-
-  // applying rotations and scaling
-  model.rotate(rotX, 1.0, 0.0, 0.0);
-  model.rotate(rotY, 0.0, 1.0, 0.0);
-  model.rotate(rotZ, 0.0, 0.0, 1.0);
-  model.scale(scaling);
-  knotModel.rotate(rotX, 1.0, 0.0, 0.0);
-  knotModel.rotate(rotY, 0.0, 1.0, 0.0);
-  knotModel.rotate(rotZ, 0.0, 0.0, 1.0);
-  knotModel.scale(scaling);
+  // Only the local transformations change; the scene graph marks the affected
+  // subtrees dirty and recomputes their world transformations on the next draw
+  QQuaternion rotation = QQuaternion::fromAxisAndAngle(1.0, 0.0, 0.0, rotX) *
+                         QQuaternion::fromAxisAndAngle(0.0, 1.0, 0.0, rotY) *
+                         QQuaternion::fromAxisAndAngle(0.0, 0.0, 1.0, rotZ);
+  for (SceneNode *node : {pyramidNode, knotNode}) {
+    node->setRotation(rotation);
+    node->setScale(scaling);
+  }
 
   // updating the model
+  invalidate(SceneDirty);
+}
+
+/**
+ * @brief MainView::invalidate Marks part of the view as changed and schedules
+ * a frame. Changes that do not affect the image should not call this.
+ * @param flags Combination of Dirty flags.
+ */
+void MainView::invalidate(int flags) {
+  dirty |= flags;
   update();
 }
 
+/**
+ * @brief MainView::setCamera Selects from where the view shows the scene.
+ * @param camera The perspective camera, or one of the orthographic views.
+ */
+void MainView::setCamera(Camera camera) {
+  this->camera = camera;
+  resizeGL(width(), height());
+  invalidate(CameraDirty);
+}
+
 /**
  * @brief MainView::setRotation Changes the rotation of the displayed objects.
  * @param rotateX Number of degrees to rotate around the x axis.
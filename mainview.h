@@ -1,6 +1,7 @@
 #ifndef MAINVIEW_H
 #define MAINVIEW_H
 
+#include <QElapsedTimer>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QOpenGLDebugLogger>
@@ -10,8 +11,22 @@
 #include <QTimer>
 #include <QVector3D>
 
+#include "instanceculler.h"
+#include "lightclusters.h"
+#include "meshdeformer.h"
+#include "mesh.h"
 #include "model.h"
+#include "occlusionculler.h"
+#include "postchain.h"
+#include "rendergraph.h"
+#include "resolutioncontroller.h"
+#include "scenenode.h"
+#include "shadowmap.h"
+#include "sharedgeometry.h"
+#include "softwareoccluder.h"
+#include "uploadworker.h"
 #include "vertex.h"
+#include "vertexpuller.h"
 
 /**
  * @brief The MainView class is resonsible for the actual content of the main
@@ -24,11 +39,30 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   MainView(QWidget *parent = nullptr);
   ~MainView() override;
 
+  // Viewpoints of the views in the window; the orthographic ones look at the
+  // middle of the scene
+  enum Camera { Perspective, Top, Front, Side };
+  void setCamera(Camera camera);
+
+  // Smoothed times of the last frames, in milliseconds
+  float getCpuTime() const { return resolutionController.getCpuTime(); }
+  float getGpuTime() const { return resolutionController.getGpuTime(); }
+
   // Functions for widget input events
   void setRotation(int rotateX, int rotateY, int rotateZ);
   void setScale(float scale);
   void rotateAndScale();
 
+  // What changed since the last frame; a frame is only drawn if anything did
+  enum Dirty {
+    SceneDirty = 1,
+    CameraDirty = 2,
+    ViewportDirty = 4,
+    SettingsDirty = 8,
+    AllDirty = 15
+  };
+  void invalidate(int flags);
+
  protected:
   void initializeGL() override;
   void resizeGL(int newWidth, int newHeight) override;
@@ -47,44 +81,190 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
 
  private slots:
   void onMessageLogged(QOpenGLDebugMessage Message);
+  void reloadAsset(const QString &resource, int change);
 
  private:
   QOpenGLDebugLogger debugLogger;
   QTimer timer;  // timer used for animation
 
-  QOpenGLShaderProgram shaderProgram;
+  // Frames are only drawn after an invalidation; otherwise the widget keeps
+  // showing the last one. Continuous rendering for animation is toggled with
+  // 'C'
+  static constexpr int settleFrameCount = 2;
+  int dirty = AllDirty;
+  int settleFrames = 0;
+  bool finalFrame = false;  // the last before going idle
+  bool continuousRendering = false;
+
+  // Meshes and programs shared with the other views of the window
+  SharedGeometry *shared = nullptr;
+  Camera camera = Perspective;
+
+  // Indices of the meshes, in upload order
+  enum { PyramidMesh, KnotMesh, FloorMesh };
 
-  void fillArrayAndBuffer(GLuint buf, GLuint arr, int size, Vertex *vertices);
+  void uploadMeshes();
+  void createSharedResources();
+  void createShadowMaps();
+  int addMesh(int size, Vertex *vertices);
+  int addPositionMesh(const QVector<QVector3D> &positions);
+  void buildLods(int meshIndex, const QVector<QVector3D> &positions);
+  void createVertexArrays(Mesh &mesh);
+  void buildInstanceField();
+  void buildKnotTargets();
+  void deformKnot();
+  int enqueueModel(const QString &path);
+  void loadModelInBackground();
+  void addStreamedModels();
+  void releaseEvicted();
+  void reloadShaders(const QString &resource);
+  void replaceSharedMesh(int meshIndex, const UploadWorker::Resource &resource);
+  void refreshSharedMeshes();
+  void keepResident(QVector<SceneNode *> &drawables);
+  void selectLods(const QVector<SceneNode *> &drawables);
+  void drawMesh(const Mesh &mesh, int lod);
+  void drawNode(SceneNode *node);
+  void buildFrameGraph(const QVector<SceneNode *> &drawables,
+                       const QVector<SceneNode *> &casters);
+  void drawScene(const QVector<SceneNode *> &drawables);
+  bool isPulled(const SceneNode *node) const;
+  void setLightingUniforms(ShaderVariants::Variant &variant);
+  void updateShadowMaps(const QVector<SceneNode *> &casters);
+  void drawDepthPrepass(const QVector<SceneNode *> &drawables);
+  void cullWithSoftwareOccluder(QVector<SceneNode *> &drawables);
+  void drawOccluderDepth();
   void specifyDataLayout();
   void createShaderProgram();
 
-  // Pyramid vertices
-  Vertex a {-1,1,1,1,0,0};
-  Vertex b {1,1,1,0,1,0};
-  Vertex c {0,0,-1,1,0,1};
-  Vertex d {1,-1,1,1,1,0};
-  Vertex e {-1,-1,1,0,0,1};
+  // Shared meshes with the vertex arrays of this view, referenced by index
+  // from the scene nodes
+  QVector<Mesh> meshes;
+
+  // Scene graph holding the transformations of the pyramid and the knot
+  SceneNode scene{"root"};
+  SceneNode *pyramidNode;
+  SceneNode *knotNode;
+  SceneNode *floorNode;
+
+  // Hardware occlusion culling of heavy meshes, toggled with 'O'
+  OcclusionCuller occlusionCuller;
+  bool occlusionCulling = false;
+
+  // CPU occlusion culling against selected occluders, toggled with 'S'; its
+  // depth buffer is shown in a corner of the view with 'D'
+  SoftwareOccluder softwareOccluder;
+  bool softwareCulling = false;
+  bool showOccluderDepth = false;
+  GLuint occluderDepthTexture;
+  GLint depthViewNearLoc;
+  GLint depthViewFarLoc;
+  GLint depthViewOrthoLoc;
+
+  // Drawing the scene in one draw call with vertex pulling, toggled with 'V'
+  VertexPuller vertexPuller;
+  bool vertexPulling = false;
+
+  // Screen-space-error level of detail selection, toggled with 'L'
+  bool lodSelection = false;
+  float lodTolerance = 1.0f;  // pixels
+  float focalLength = 1.0f;   // pixels per unit at unit distance
 
-  // Array of pyramid vertices arranged painstakingly :(
-  Vertex pyramid[18] = {a,e,d,b,a,d,d,c,b,b,c,a,a,c,e,e,c,d};
+  // Clustered forward lighting with many point lights, toggled with 'K'; the
+  // clusters are shared
+  QVector<PointLight> lights;
+  bool clusteredLighting = false;
 
-  // For VBO and VAO of the pyramid and the knot
-  GLuint buffer;
-  GLuint array;
+  // Cached shadow maps of a sun and a spot light in the lit program, toggled
+  // with 'H'. Every view has its own, as streamed models and the deformed knot
+  // cast shadows in one view only
+  ShadowMap shadowMaps[2];
+  GLuint shadowFramebuffers[2];
+  int shadowResource = -1;
+  bool shadows = false;
 
-  GLuint knotVBO;
-  GLuint knotVAO;
+  // Passes of the frame, rebuilt every frame from the enabled features. Its
+  // targets and the buffers culled into by the instance culler count towards
+  // the shared memory budget as pinned resources of this view
+  RenderGraph frameGraph;
+  int targetResource = -1;
+  int cullResource = -1;
+  int viewportWidth = 1;   // pixels
+  int viewportHeight = 1;  // pixels
+  GLuint emptyVAO;         // for the full-screen passes
 
-  // Creating QMatrix4x4 member representing Model transformation for the pyramid and for the knot
-  QMatrix4x4 model;
-  QMatrix4x4 knotModel;
+  // Depth-only pre-pass before shading, toggled with 'Z'
+  bool depthPrepass = false;
+  GLint prepassModLoc;
+  GLint prepassViewLoc;
+  GLint prepassProjLoc;
+
+  // Internal resolution of the scene, adjusted to hold the frame time and
+  // upscaled to the widget; toggled with 'R'
+  ResolutionController resolutionController;
+  bool dynamicResolution = true;
+
+  // Post-processing of the rendered scene, toggled with 'P'; 'J' adds
+  // sharpening between the fused effects
+  PostChain postChain;
+  bool postProcessing = false;
+  bool sharpening = false;
+  void updatePostEffects();
+
+  // Field of knot instances frustum culled on the GPU, toggled with 'I';
+  // distant knots are drawn as impostors. The field and its impostor are
+  // shared, and created when a view first shows them
+  InstanceCuller instanceCuller;
+  bool showInstances = false;
+
+  // Spray of particles simulated on the GPU, toggled with 'G'; animates
+  // without continuous rendering. The particles are shared, and created when
+  // a view first shows them; these vertex arrays read them
+  static constexpr int particleCount = 1 << 20;
+  static constexpr float particleSize = 0.025f;  // units
+  GLuint particleVAOs[2] = {};
+  bool showParticles = false;
+
+  // Morph target animation of the knot on the CPU, toggled with 'M'; the
+  // static vertex arrays of the knot are kept in staticKnot while it is
+  // deformed. Created when first shown
+  MeshDeformer knotDeformer;
+  QElapsedTimer morphClock;
+  Mesh staticKnot;
+  bool morphing = false;
+
+  // Models loaded and uploaded on a worker thread, added to the scene with
+  // 'N' once their buffers are complete. Their meshes follow the shared ones,
+  // and are evicted by the memory budget when unused; reloads maps the
+  // tickets of evicted meshes being loaded again to their indices
+  UploadWorker *uploadWorker = nullptr;
+  QHash<int, int> reloads;
+
+  // Development mode: meshes and programs are reloaded when their files under
+  // ASSET_DIR change. The shared meshes of this view match the shared
+  // geometry as of this count of its reloads
+  int meshGeneration = 0;
 
   // Creating QMatrix4x4 member represeting Projection transformations for the pyramid
   QMatrix4x4 projection;
 
-  // Model Location and Projection Location
-  GLint modLoc;
-  GLint projLoc;
+  // View transformation of the camera, the identity for the perspective one,
+  // and the planes of the projection
+  QMatrix4x4 view;
+  float nearPlane = 0.2f;
+  float farPlane = 20.0f;
+
+  // Bits of the lighting features in the variant masks of the scene and the
+  // vertex pulling shaders, and of the position-only one in the former
+  quint32 sceneLighting;
+  quint32 sceneShadows;
+  quint32 scenePositionOnly;
+  quint32 pullLighting;
+  quint32 pullShadows;
+
+  // Variants shading the scene this frame, indexed by Mesh::positionOnly,
+  // and the one bound
+  ShaderVariants::Variant *sceneVariants[2] = {};
+  ShaderVariants::Variant *boundVariant = nullptr;
 
   // Rotation and scaling variables
   int rotX = 0;
@@ -2,6 +2,10 @@
 
 #include "ui_mainwindow.h"
 
+#ifdef HAVE_RHI_VIEW
+#include "rhiview.h"
+#endif
+
 /**
  * @brief MainWindow::MainWindow Constructs a new main window.
  * @param parent The parent widget.
@@ -9,12 +13,104 @@
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow) {
   ui->setupUi(this);
+
+  // The views share one context group, so the meshes are uploaded once
+  ui->topView->setCamera(MainView::Top);
+  ui->frontView->setCamera(MainView::Front);
+  ui->sideView->setCamera(MainView::Side);
+
+#ifndef HAVE_RHI_VIEW
+  ui->RhiViewButton->hide();
+#endif
+
+  // Frame times of the perspective view and the QRhi view, side by side
+  connect(&frameTimeTimer, &QTimer::timeout, this, &MainWindow::showFrameTimes);
+  frameTimeTimer.start(500);
+}
+
+/**
+ * @brief MainWindow::views Returns the views of the window, which all show
+ * the same transformations of the objects.
+ * @return The perspective view followed by the orthographic ones.
+ */
+QVector<MainView *> MainWindow::views() const {
+  return {ui->mainView, ui->topView, ui->frontView, ui->sideView};
+}
+
+/**
+ * @brief MainWindow::setRotation Rotates the objects in every view.
+ * @param rotateX Number of degrees to rotate around the x axis.
+ * @param rotateY Number of degrees to rotate around the y axis.
+ * @param rotateZ Number of degrees to rotate around the z axis.
+ */
+void MainWindow::setRotation(int rotateX, int rotateY, int rotateZ) {
+  for (MainView *view : views()) view->setRotation(rotateX, rotateY, rotateZ);
+#ifdef HAVE_RHI_VIEW
+  if (rhiView) rhiView->setRotation(rotateX, rotateY, rotateZ);
+#endif
+}
+
+/**
+ * @brief MainWindow::setScale Scales the objects in every view.
+ * @param scale The new scale factor.
+ */
+void MainWindow::setScale(float scale) {
+  for (MainView *view : views()) view->setScale(scale);
+#ifdef HAVE_RHI_VIEW
+  if (rhiView) rhiView->setScale(scale);
+#endif
+}
+
+/**
+ * @brief MainWindow::on_RhiViewButton_clicked Shows the scene rendered through
+ * QRhi in a window of its own, as it cannot be composed with the OpenGL views.
+ * The button is hidden in builds without the view.
+ * @param checked Unused.
+ */
+void MainWindow::on_RhiViewButton_clicked(bool checked) {
+  Q_UNUSED(checked)
+#ifdef HAVE_RHI_VIEW
+  if (!rhiView) {
+    rhiView = new RhiView;
+    rhiView->setWindowTitle("QRhi View");
+    rhiView->resize(ui->mainView->size());
+    rhiView->setRotation(ui->RotationDialX->value(), ui->RotationDialY->value(),
+                         ui->RotationDialZ->value());
+    rhiView->setScale(ui->ScaleSlider->value() / 100.0f);
+  }
+  rhiView->show();
+  rhiView->raise();
+#endif
+}
+
+/**
+ * @brief MainWindow::showFrameTimes Shows the smoothed frame times of the
+ * OpenGL and the QRhi perspective views.
+ */
+void MainWindow::showFrameTimes() {
+  QString text = QString("OpenGL: %1 ms CPU, %2 ms GPU")
+                     .arg(ui->mainView->getCpuTime(), 0, 'f', 2)
+                     .arg(ui->mainView->getGpuTime(), 0, 'f', 2);
+#ifdef HAVE_RHI_VIEW
+  if (rhiView && rhiView->isVisible()) {
+    text += QString("\nQRhi (%1): %2 ms CPU, %3 ms GPU")
+                .arg(rhiView->getBackendName())
+                .arg(rhiView->getCpuTime(), 0, 'f', 2)
+                .arg(rhiView->getGpuTime(), 0, 'f', 2);
+  }
+#endif
+  ui->frameTimeLabel->setText(text);
 }
 
 /**
  * @brief MainWindow::~MainWindow Destructor.
  */
-MainWindow::~MainWindow() { delete ui; }
+MainWindow::~MainWindow() {
+#ifdef HAVE_RHI_VIEW
+  delete rhiView;
+#endif
+  delete ui;
+}
 
 /**
  * @brief MainWindow::on_ResetRotationButton_clicked Resets the rotation.
@@ -25,7 +121,7 @@ void MainWindow::on_ResetRotationButton_clicked(bool checked) {
   ui->RotationDialX->setValue(0);
   ui->RotationDialY->setValue(0);
   ui->RotationDialZ->setValue(0);
-  ui->mainView->setRotation(0, 0, 0);
+  setRotation(0, 0, 0);
 }
 
 /**
@@ -34,8 +130,7 @@ void MainWindow::on_ResetRotationButton_clicked(bool checked) {
  * @param value Unused.
  */
 void MainWindow::on_RotationDialX_sliderMoved(int value) {
-  ui->mainView->setRotation(value, ui->RotationDialY->value(),
-                            ui->RotationDialZ->value());
+  setRotation(value, ui->RotationDialY->value(), ui->RotationDialZ->value());
 }
 
 /**
@@ -44,8 +139,7 @@ void MainWindow::on_RotationDialX_sliderMoved(int value) {
  * @param value Unused.
  */
 void MainWindow::on_RotationDialY_sliderMoved(int value) {
-  ui->mainView->setRotation(ui->RotationDialX->value(), value,
-                            ui->RotationDialZ->value());
+  setRotation(ui->RotationDialX->value(), value, ui->RotationDialZ->value());
 }
 
 /**
@@ -54,8 +148,7 @@ void MainWindow::on_RotationDialY_sliderMoved(int value) {
  * @param value Unused.
  */
 void MainWindow::on_RotationDialZ_sliderMoved(int value) {
-  ui->mainView->setRotation(ui->RotationDialX->value(),
-                            ui->RotationDialY->value(), value);
+  setRotation(ui->RotationDialX->value(), ui->RotationDialY->value(), value);
 }
 
 /**
@@ -65,7 +158,7 @@ void MainWindow::on_RotationDialZ_sliderMoved(int value) {
 void MainWindow::on_ResetScaleButton_clicked(bool checked) {
   Q_UNUSED(checked)
   ui->ScaleSlider->setValue(100);
-  ui->mainView->setScale(100);
+  setScale(100);
 }
 
 /**
@@ -73,7 +166,7 @@ void MainWindow::on_ResetScaleButton_clicked(bool checked) {
  * @param value The new scale value.
  */
 void MainWindow::on_ScaleSlider_sliderMoved(int value) {
-  ui->mainView->setScale(value / 100.0f);
+  setScale(value / 100.0f);
 }
 
 /**
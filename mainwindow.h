@@ -2,6 +2,11 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QTimer>
+#include <QVector>
+
+class MainView;
+class RhiView;
 
 namespace Ui {
 class MainWindow;
@@ -29,6 +34,19 @@ class MainWindow : public QMainWindow {
 
   void on_ResetScaleButton_clicked(bool checked);
   void on_ScaleSlider_sliderMoved(int value);
+
+  void on_RhiViewButton_clicked(bool checked);
+  void showFrameTimes();
+
+ private:
+  QVector<MainView *> views() const;
+  void setRotation(int rotateX, int rotateY, int rotateZ);
+  void setScale(float scale);
+
+  // Same scene rendered through QRhi, in a window of its own once shown; only
+  // in builds with the view, see RhiView
+  RhiView *rhiView = nullptr;
+  QTimer frameTimeTimer;
 };
 
 #endif  // MAINWINDOW_H
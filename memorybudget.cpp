@@ -0,0 +1,118 @@
+#include "memorybudget.h"
+
+#include <QDebug>
+
+/**
+ * @brief MemoryBudget::add Registers a resident resource, used this frame.
+ * @param source Model path or cache entry the resource can be loaded from.
+ * @param bytes Size of the resource on the GPU.
+ * @param buffers Buffers of the resource, deleted on eviction.
+ * @param textures Textures of the resource, deleted on eviction.
+ * @param evictable False for resources that are never evicted.
+ * @return Identifier of the resource.
+ */
+int MemoryBudget::add(const QString &source, qint64 bytes,
+                      const QVector<GLuint> &buffers,
+                      const QVector<GLuint> &textures, bool evictable) {
+  Resource resource;
+  resource.source = source;
+  resource.bytes = bytes;
+  resource.buffers = buffers;
+  resource.textures = textures;
+  resource.lastUsed = frame;
+  resource.resident = true;
+  resource.evictable = evictable;
+  resources.append(resource);
+  usage += bytes;
+  return resources.size() - 1;
+}
+
+/**
+ * @brief MemoryBudget::restore Marks an evicted resource resident again, with
+ * the objects it was loaded into.
+ * @param id Identifier of the resource.
+ * @param buffers New buffers of the resource.
+ * @param textures New textures of the resource.
+ */
+void MemoryBudget::restore(int id, const QVector<GLuint> &buffers,
+                           const QVector<GLuint> &textures) {
+  Resource &resource = resources[id];
+  if (resource.resident) return;
+  resource.buffers = buffers;
+  resource.textures = textures;
+  resource.lastUsed = frame;
+  resource.resident = true;
+  usage += resource.bytes;
+}
+
+/**
+ * @brief MemoryBudget::remove Deletes the objects of a resource that is no
+ * longer needed.
+ * @param gl OpenGL functions of the current context.
+ * @param id Identifier of the resource.
+ */
+void MemoryBudget::remove(QOpenGLFunctions_3_3_Core *gl, int id) {
+  release(gl, resources[id]);
+}
+
+/**
+ * @brief MemoryBudget::resize Changes the size of a resident resource, such
+ * as a pinned one that is rebuilt or grows with its contents.
+ * @param id Identifier of the resource.
+ * @param bytes New size of the resource on the GPU.
+ */
+void MemoryBudget::resize(int id, qint64 bytes) {
+  Resource &resource = resources[id];
+  if (resource.resident) usage += bytes - resource.bytes;
+  resource.bytes = bytes;
+}
+
+/**
+ * @brief MemoryBudget::use Marks a resource as used this frame.
+ * @param id Identifier of the resource.
+ * @return Whether the resource is resident; if not, it has to be loaded again
+ * before it can be used.
+ */
+bool MemoryBudget::use(int id) {
+  Resource &resource = resources[id];
+  resource.lastUsed = frame;
+  return resource.resident;
+}
+
+/**
+ * @brief MemoryBudget::endFrame Evicts the least recently used resources
+ * until the usage fits the budget, then starts the next frame. Resources used
+ * this frame are kept, even if that exceeds the budget.
+ * @param gl OpenGL functions of the current context.
+ */
+void MemoryBudget::endFrame(QOpenGLFunctions_3_3_Core *gl) {
+  while (usage > budget) {
+    Resource *oldest = nullptr;
+    for (Resource &resource : resources) {
+      if (!resource.resident || !resource.evictable) continue;
+      if (resource.lastUsed == frame) continue;
+      if (!oldest || resource.lastUsed < oldest->lastUsed) oldest = &resource;
+    }
+    if (!oldest) break;
+    qDebug() << ":: Evicting" << oldest->source << "unused for"
+             << frame - oldest->lastUsed << "frames";
+    release(gl, *oldest);
+    if (oldest->evicted) oldest->evicted();
+  }
+  frame++;
+}
+
+/**
+ * @brief MemoryBudget::release Deletes the objects of a resident resource.
+ * @param gl OpenGL functions of the current context.
+ * @param resource Resource to release.
+ */
+void MemoryBudget::release(QOpenGLFunctions_3_3_Core *gl, Resource &resource) {
+  if (!resource.resident) return;
+  gl->glDeleteBuffers(resource.buffers.size(), resource.buffers.constData());
+  gl->glDeleteTextures(resource.textures.size(), resource.textures.constData());
+  resource.buffers.clear();
+  resource.textures.clear();
+  resource.resident = false;
+  usage -= resource.bytes;
+}
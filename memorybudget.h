@@ -0,0 +1,69 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+/**
+ * @brief Tracks the GPU memory of buffers and textures against a budget.
+ *
+ * Every registered resource records its size, the frame it was last used in
+ * and the source it can be loaded again from. Frames are those of the whole
+ * context group, in which every view draws once, so a resource used by any
+ * view counts as used. At the end of a frame, while the total exceeds the
+ * budget, the least recently used evictable resource not used in that frame
+ * has its objects deleted. Users check residency with use() before drawing
+ * and load evicted resources again from their source; resources that cannot
+ * be restored that way are registered as pinned, and only count towards the
+ * total.
+ *
+ * Deleted buffers are only freed once no vertex array refers to them, and
+ * vertex arrays belong to the context of one view, which may not be the one
+ * evicting. A resource can therefore have an eviction handler, which lets its
+ * owner delete the vertex arrays in its own context.
+ */
+class MemoryBudget {
+ public:
+  void setBudget(qint64 bytes) { budget = bytes; }
+  qint64 getBudget() const { return budget; }
+  qint64 getUsage() const { return usage; }
+
+  int add(const QString &source, qint64 bytes, const QVector<GLuint> &buffers,
+          const QVector<GLuint> &textures = {}, bool evictable = true);
+  void restore(int id, const QVector<GLuint> &buffers,
+               const QVector<GLuint> &textures = {});
+  void remove(QOpenGLFunctions_3_3_Core *gl, int id);
+  void resize(int id, qint64 bytes);
+  void setEvictionHandler(int id, std::function<void()> handler) {
+    resources[id].evicted = handler;
+  }
+
+  bool use(int id);
+  bool isResident(int id) const { return resources[id].resident; }
+  const QString &getSource(int id) const { return resources[id].source; }
+
+  void endFrame(QOpenGLFunctions_3_3_Core *gl);
+
+ private:
+  struct Resource {
+    QString source;  // model path or cache entry to load it again from
+    qint64 bytes = 0;
+    QVector<GLuint> buffers;
+    QVector<GLuint> textures;
+    quint64 lastUsed = 0;  // frame
+    bool resident = false;
+    bool evictable = false;
+    std::function<void()> evicted;  // called after eviction, if set
+  };
+
+  void release(QOpenGLFunctions_3_3_Core *gl, Resource &resource);
+
+  QVector<Resource> resources;
+  qint64 budget = qint64(256) << 20;  // bytes
+  qint64 usage = 0;                   // bytes, resident resources
+  quint64 frame = 0;
+};
+
+#endif  // MEMORYBUDGET_H
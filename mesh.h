@@ -0,0 +1,36 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <QOpenGLFunctions_3_3_Core>
+
+#include "bounds.h"
+#include "lod.h"
+
+// Defining the GPU side of a mesh: its buffers, draw count and object-space bounds
+struct Mesh {
+  GLuint vbo = 0;
+  GLuint vao = 0;
+  GLsizei count = 0;
+  AABB bounds;
+
+  // Element buffer holding the index ranges of all levels of detail; meshes
+  // without levels are drawn with glDrawArrays
+  GLuint ebo = 0;
+  QVector<LodLevel> lods;
+
+  // De-interleaved copy of the positions, used by the depth pre-pass
+  GLuint positionVBO = 0;
+  GLuint positionVAO = 0;
+
+  // Only positions are stored, in vbo, which is then also the positionVBO;
+  // the shaders derive the colors from them
+  bool positionOnly = false;
+
+  // Index of the mesh in the software occluder, -1 if it does not occlude
+  int occluder = -1;
+
+  // Identifier of the buffers in the memory budget, -1 if not tracked
+  int resource = -1;
+};
+
+#endif  // MESH_H
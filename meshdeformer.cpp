@@ -0,0 +1,235 @@
+#include "meshdeformer.h"
+
+#include <QThread>
+#include <cstddef>
+
+#include "vertex.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DEFORMER_SSE
+#endif
+
+/**
+ * @brief MeshDeformer::MeshDeformer Constructs a deformer using one thread per
+ * hardware thread.
+ */
+MeshDeformer::MeshDeformer() {
+  pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+/**
+ * @brief MeshDeformer::initialize Creates the position buffers and vertex
+ * arrays for a mesh.
+ * @param functions OpenGL functions of the current context.
+ * @param mesh Mesh to deform; its buffers provide the colors and elements.
+ * @param positions Base positions of the vertices of the mesh.
+ */
+void MeshDeformer::initialize(QOpenGLFunctions_3_3_Core *functions,
+                              const Mesh &mesh,
+                              const QVector<QVector3D> &positions) {
+  gl = functions;
+  count = positions.size();
+  baseX.resize(count);
+  baseY.resize(count);
+  baseZ.resize(count);
+  for (int i = 0; i < count; i++) {
+    baseX[i] = positions[i].x();
+    baseY[i] = positions[i].y();
+    baseZ[i] = positions[i].z();
+  }
+  bounds = AABB::fromPoints(positions);
+
+  gl->glGenBuffers(2, buffers);
+  gl->glGenVertexArrays(2, vaos);
+  for (int i = 0; i < 2; i++) {
+    gl->glBindVertexArray(vaos[i]);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+    gl->glBufferData(GL_ARRAY_BUFFER, 3 * count * sizeof(GLfloat), nullptr,
+                     GL_STREAM_DRAW);
+    positionFormat.specify(gl);
+    if (!mesh.positionOnly) {
+      gl->glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+      vertexFormat.specifyAttribute(gl, 1, 1);
+    }
+    if (mesh.ebo) gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+  }
+  gl->glBindVertexArray(0);
+}
+
+/**
+ * @brief MeshDeformer::destroy Deletes the buffers and fences and drops the
+ * targets, so the deformer can be initialized again.
+ */
+void MeshDeformer::destroy() {
+  if (!gl) return;
+  for (GLsync &sync : fences) {
+    if (sync) gl->glDeleteSync(sync);
+    sync = nullptr;
+  }
+  gl->glDeleteBuffers(2, buffers);
+  gl->glDeleteVertexArrays(2, vaos);
+  gl = nullptr;
+  count = 0;
+  targets.clear();
+  weights.clear();
+}
+
+/**
+ * @brief MeshDeformer::addTarget Adds a morph target with weight zero.
+ * @param offsets Offset of every vertex from its base position.
+ * @return Index of the target, to be used with setWeight().
+ */
+int MeshDeformer::addTarget(const QVector<QVector3D> &offsets) {
+  Target target;
+  target.x.resize(count);
+  target.y.resize(count);
+  target.z.resize(count);
+  for (int i = 0; i < count; i++) {
+    target.x[i] = offsets[i].x();
+    target.y[i] = offsets[i].y();
+    target.z[i] = offsets[i].z();
+  }
+  targets.append(target);
+  weights.append(0.0f);
+  return targets.size() - 1;
+}
+
+/**
+ * @brief MeshDeformer::update Blends the targets with their current weights
+ * into the position buffer the GPU is not reading, and makes it current.
+ */
+void MeshDeformer::update() {
+  int next = 1 - current;
+  gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[next]);
+
+  // Still read by an earlier frame: new storage instead of a stall
+  if (fences[next]) {
+    if (gl->glClientWaitSync(fences[next], 0, 0) == GL_TIMEOUT_EXPIRED) {
+      gl->glBufferData(GL_ARRAY_BUFFER, 3 * count * sizeof(GLfloat), nullptr,
+                       GL_STREAM_DRAW);
+    }
+    gl->glDeleteSync(fences[next]);
+    fences[next] = nullptr;
+  }
+
+  auto *out = static_cast<float *>(gl->glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, 3 * count * sizeof(GLfloat),
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT));
+  if (!out) {
+    qDebug() << ":: Could not map the deformed positions";
+    return;
+  }
+
+  // Ranges are a multiple of four vertices, so only the last one has a tail
+  int ranges = pool.maxThreadCount();
+  int rangeSize = ((count + ranges - 1) / ranges + 3) & ~3;
+  QVector<AABB> rangeBounds(ranges);
+  for (int i = 0; i < ranges; i++) {
+    int begin = i * rangeSize;
+    int end = qMin(begin + rangeSize, count);
+    if (begin >= end) break;
+    AABB *box = &rangeBounds[i];
+    pool.start([this, begin, end, out, box] {
+      deformRange(begin, end, out, *box);
+    });
+  }
+  pool.waitForDone();
+  gl->glUnmapBuffer(GL_ARRAY_BUFFER);
+
+  bounds = AABB();
+  for (const AABB &box : rangeBounds) bounds.expand(box);
+  current = next;
+}
+
+/**
+ * @brief MeshDeformer::fence Marks the end of the commands drawing the current
+ * positions, after which the buffer may be written again.
+ */
+void MeshDeformer::fence() {
+  if (fences[current]) gl->glDeleteSync(fences[current]);
+  fences[current] = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * @brief MeshDeformer::deformRange Blends the positions of a range of
+ * vertices. Called from the worker threads.
+ * @param begin First vertex.
+ * @param end Vertex after the last one.
+ * @param out Interleaved positions of all vertices.
+ * @param rangeBounds Receives the bounds of the range.
+ */
+void MeshDeformer::deformRange(int begin, int end, float *out,
+                               AABB &rangeBounds) const {
+  int i = begin;
+#ifdef DEFORMER_SSE
+  __m128 lowerX = _mm_set1_ps(FLT_MAX);
+  __m128 lowerY = lowerX;
+  __m128 lowerZ = lowerX;
+  __m128 upperX = _mm_set1_ps(-FLT_MAX);
+  __m128 upperY = upperX;
+  __m128 upperZ = upperX;
+  for (; i + 4 <= end; i += 4) {
+    __m128 x = _mm_loadu_ps(baseX.constData() + i);
+    __m128 y = _mm_loadu_ps(baseY.constData() + i);
+    __m128 z = _mm_loadu_ps(baseZ.constData() + i);
+    for (int t = 0; t < targets.size(); t++) {
+      if (weights[t] == 0.0f) continue;
+      __m128 w = _mm_set1_ps(weights[t]);
+      const Target &target = targets[t];
+      x = _mm_add_ps(x, _mm_mul_ps(w, _mm_loadu_ps(target.x.constData() + i)));
+      y = _mm_add_ps(y, _mm_mul_ps(w, _mm_loadu_ps(target.y.constData() + i)));
+      z = _mm_add_ps(z, _mm_mul_ps(w, _mm_loadu_ps(target.z.constData() + i)));
+    }
+    lowerX = _mm_min_ps(lowerX, x);
+    lowerY = _mm_min_ps(lowerY, y);
+    lowerZ = _mm_min_ps(lowerZ, z);
+    upperX = _mm_max_ps(upperX, x);
+    upperY = _mm_max_ps(upperY, y);
+    upperZ = _mm_max_ps(upperZ, z);
+
+    // Interleaving x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    __m128 xyLow = _mm_unpacklo_ps(x, y);
+    __m128 xyHigh = _mm_unpackhi_ps(x, y);
+    __m128 yzLow = _mm_unpacklo_ps(y, z);
+    __m128 yzHigh = _mm_unpackhi_ps(y, z);
+    __m128 zxLow = _mm_unpacklo_ps(z, x);
+    __m128 zxHigh = _mm_unpackhi_ps(z, x);
+    float *v = out + 3 * i;
+    _mm_storeu_ps(v, _mm_shuffle_ps(xyLow, zxLow, _MM_SHUFFLE(3, 0, 1, 0)));
+    _mm_storeu_ps(v + 4, _mm_shuffle_ps(yzLow, xyHigh, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_storeu_ps(v + 8, _mm_shuffle_ps(zxHigh, yzHigh, _MM_SHUFFLE(3, 2, 3, 0)));
+  }
+  if (i > begin) {
+    float lower[3][4];
+    float upper[3][4];
+    _mm_storeu_ps(lower[0], lowerX);
+    _mm_storeu_ps(lower[1], lowerY);
+    _mm_storeu_ps(lower[2], lowerZ);
+    _mm_storeu_ps(upper[0], upperX);
+    _mm_storeu_ps(upper[1], upperY);
+    _mm_storeu_ps(upper[2], upperZ);
+    for (int lane = 0; lane < 4; lane++) {
+      rangeBounds.expand(
+          QVector3D(lower[0][lane], lower[1][lane], lower[2][lane]));
+      rangeBounds.expand(
+          QVector3D(upper[0][lane], upper[1][lane], upper[2][lane]));
+    }
+  }
+#endif
+  for (; i < end; i++) {
+    float x = baseX[i];
+    float y = baseY[i];
+    float z = baseZ[i];
+    for (int t = 0; t < targets.size(); t++) {
+      x += weights[t] * targets[t].x[i];
+      y += weights[t] * targets[t].y[i];
+      z += weights[t] * targets[t].z[i];
+    }
+    out[3 * i] = x;
+    out[3 * i + 1] = y;
+    out[3 * i + 2] = z;
+    rangeBounds.expand(QVector3D(x, y, z));
+  }
+}
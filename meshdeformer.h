@@ -0,0 +1,74 @@
+#ifndef MESHDEFORMER_H
+#define MESHDEFORMER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QThreadPool>
+#include <QVector3D>
+#include <QVector>
+
+#include "bounds.h"
+#include "mesh.h"
+
+/**
+ * @brief Animates the vertices of a mesh on the CPU and streams them to the
+ * GPU.
+ *
+ * The deformed positions are the base positions plus a weighted sum of morph
+ * targets, stored as per-vertex offsets. Procedural deformations fit the same
+ * scheme: a wave travelling over the mesh is the sum of a sine and a cosine
+ * target, weighted with the cosine and sine of its phase. Positions and
+ * offsets are kept as separate x, y and z arrays, so the blend runs four
+ * vertices at a time with SSE, on one range of vertices per hardware thread.
+ *
+ * The results are written straight into one of two position buffers while
+ * the GPU may still read the other. Each buffer is fenced after the frame
+ * that draws it; if the GPU has not passed that fence when the buffer comes
+ * around again, its storage is orphaned instead of waited for. Stored colors
+ * and level-of-detail elements stay in the static buffers of the mesh.
+ */
+class MeshDeformer {
+ public:
+  MeshDeformer();
+
+  void initialize(QOpenGLFunctions_3_3_Core *functions, const Mesh &mesh,
+                  const QVector<QVector3D> &positions);
+  void destroy();
+  bool isEmpty() const { return count == 0; }
+
+  // Offsets of every vertex, in the order of the base positions
+  int addTarget(const QVector<QVector3D> &offsets);
+  void setWeight(int target, float weight) { weights[target] = weight; }
+
+  // Per frame: blend and stream, draw the vertex array, then fence
+  void update();
+  void fence();
+
+  // Vertex array of the latest positions, with the layout of the mesh
+  GLuint getVertexArray() const { return vaos[current]; }
+  const AABB &getBounds() const { return bounds; }
+
+ private:
+  struct Target {
+    QVector<float> x, y, z;
+  };
+
+  void deformRange(int begin, int end, float *out, AABB &rangeBounds) const;
+
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+  QThreadPool pool;
+
+  int count = 0;
+  QVector<float> baseX, baseY, baseZ;
+  QVector<Target> targets;
+  QVector<float> weights;
+  AABB bounds;
+
+  // Double-buffered positions, each with a vertex array and the fence of
+  // the last frame that drew it
+  GLuint buffers[2] = {};
+  GLuint vaos[2] = {};
+  GLsync fences[2] = {};
+  int current = 0;
+};
+
+#endif  // MESHDEFORMER_H
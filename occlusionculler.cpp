@@ -0,0 +1,185 @@
+#include "occlusionculler.h"
+
+#include "vertex.h"
+
+namespace {
+
+// Corners of the unit cube [-1, 1]^3
+const GLfloat cubeCorners[24] = {-1, -1, -1, 1, -1, -1, 1, 1, -1, -1, 1, -1,
+                                 -1, -1, 1,  1, -1, 1,  1, 1, 1,  -1, 1, 1};
+
+// Triangles of the unit cube, counter-clockwise seen from outside
+const GLubyte cubeIndices[36] = {4, 5, 6, 4, 6, 7, 1, 0, 3, 1, 3, 2,
+                                 5, 1, 2, 5, 2, 6, 0, 4, 7, 0, 7, 3,
+                                 7, 6, 2, 7, 2, 3, 0, 1, 5, 0, 5, 4};
+
+// Distance in front of the near plane within which boxes are always visible;
+// their front faces may be clipped by it
+const float nearMargin = 0.25f;
+
+}  // namespace
+
+/**
+ * @brief OcclusionCuller::initialize Creates the bounding box proxy geometry.
+ * @param functions OpenGL functions of the current context.
+ */
+void OcclusionCuller::initialize(QOpenGLFunctions_3_3_Core *functions) {
+  gl = functions;
+
+  gl->glGenVertexArrays(1, &cubeVAO);
+  gl->glGenBuffers(1, &cubeVBO);
+  gl->glGenBuffers(1, &cubeEBO);
+
+  gl->glBindVertexArray(cubeVAO);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+  gl->glBufferData(GL_ARRAY_BUFFER, sizeof(cubeCorners), cubeCorners,
+                   GL_STATIC_DRAW);
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+  gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices,
+                   GL_STATIC_DRAW);
+
+  // Only positions; the color attribute keeps its constant default value
+  positionFormat.specify(gl);
+  gl->glBindVertexArray(0);
+}
+
+/**
+ * @brief OcclusionCuller::destroy Deletes all queries and the proxy geometry.
+ */
+void OcclusionCuller::destroy() {
+  if (!gl) return;
+  for (QueryState &state : states) gl->glDeleteQueries(2, state.queries);
+  states.clear();
+  gl->glDeleteBuffers(1, &cubeVBO);
+  gl->glDeleteBuffers(1, &cubeEBO);
+  gl->glDeleteVertexArrays(1, &cubeVAO);
+  gl = nullptr;
+}
+
+/**
+ * @brief OcclusionCuller::stateFor Returns the query state of a node, creating
+ * its queries on first use.
+ * @param node The node.
+ * @return The query state.
+ */
+OcclusionCuller::QueryState &OcclusionCuller::stateFor(SceneNode *node) {
+  auto it = states.find(node);
+  if (it == states.end()) {
+    it = states.insert(node, QueryState());
+    gl->glGenQueries(2, it->queries);
+  }
+  return *it;
+}
+
+/**
+ * @brief OcclusionCuller::beginFrame Reads back last frame's query results
+ * without waiting and splits the drawables accordingly.
+ * @param drawables All nodes to be drawn this frame.
+ * @param meshes Meshes referenced by the nodes.
+ * @param visible Receives nodes to draw directly: light meshes and heavy
+ * meshes that were visible last frame.
+ * @param deferred Receives heavy meshes that were occluded last frame; these
+ * are drawn under conditional rendering after issueQueries().
+ */
+void OcclusionCuller::beginFrame(const QVector<SceneNode *> &drawables,
+                                 const QVector<Mesh> &meshes,
+                                 QVector<SceneNode *> &visible,
+                                 QVector<SceneNode *> &deferred) {
+  frame ^= 1;
+  int previous = frame ^ 1;
+  queried.clear();
+
+  for (SceneNode *node : drawables) {
+    if (meshes[node->getMesh()].count < minVertexCount) {
+      visible.append(node);
+      continue;
+    }
+
+    QueryState &state = stateFor(node);
+    if (state.issued[previous]) {
+      GLuint available = 0;
+      gl->glGetQueryObjectuiv(state.queries[previous],
+                              GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available) {
+        GLuint passed = 0;
+        gl->glGetQueryObjectuiv(state.queries[previous], GL_QUERY_RESULT,
+                                &passed);
+        state.visible = passed != 0;
+        state.issued[previous] = false;
+      }
+    }
+    state.issued[frame] = false;
+
+    queried.append(node);
+    if (state.visible) {
+      visible.append(node);
+    } else {
+      deferred.append(node);
+    }
+  }
+}
+
+/**
+ * @brief OcclusionCuller::issueQueries Draws the bounding box of every heavy
+ * node inside an occlusion query, against the depth of what has been drawn so
+ * far. Expects a program with modelTransform, viewTransform and
+ * projectionTransform to be bound.
+ * @param modelLocation Location of the model transformation uniform.
+ * @param view View transformation of the bound program.
+ * @param nearPlane Distance to the near plane of its projection.
+ */
+void OcclusionCuller::issueQueries(GLint modelLocation, const QMatrix4x4 &view,
+                                   float nearPlane) {
+  GLboolean depthWrites;
+  gl->glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWrites);
+  gl->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  gl->glDepthMask(GL_FALSE);
+  gl->glBindVertexArray(cubeVAO);
+
+  for (SceneNode *node : queried) {
+    const AABB &bounds = node->worldBounds();
+
+    // Boxes reaching the near plane cannot be tested reliably; the view
+    // looks along -z, for either kind of projection
+    if (bounds.transformed(view).upper.z() >= -(nearPlane + nearMargin)) {
+      stateFor(node).visible = true;
+      continue;
+    }
+
+    QMatrix4x4 proxy;
+    proxy.translate(bounds.center());
+    proxy.scale(bounds.extent());
+    gl->glUniformMatrix4fv(modelLocation, 1, GL_FALSE, proxy.data());
+
+    QueryState &state = stateFor(node);
+    gl->glBeginQuery(GL_ANY_SAMPLES_PASSED, state.queries[frame]);
+    gl->glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr);
+    gl->glEndQuery(GL_ANY_SAMPLES_PASSED);
+    state.issued[frame] = true;
+  }
+
+  gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  gl->glDepthMask(depthWrites);
+}
+
+/**
+ * @brief OcclusionCuller::beginConditional Starts conditional rendering on
+ * this frame's query of the node. Does nothing if no query was issued, in which
+ * case the node is drawn unconditionally.
+ * @param node The node about to be drawn.
+ */
+void OcclusionCuller::beginConditional(SceneNode *node) {
+  QueryState &state = stateFor(node);
+  if (state.issued[frame]) {
+    gl->glBeginConditionalRender(state.queries[frame], GL_QUERY_WAIT);
+  }
+}
+
+/**
+ * @brief OcclusionCuller::endConditional Ends conditional rendering started by
+ * beginConditional().
+ * @param node The node that was drawn.
+ */
+void OcclusionCuller::endConditional(SceneNode *node) {
+  if (stateFor(node).issued[frame]) gl->glEndConditionalRender();
+}
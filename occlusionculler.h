@@ -0,0 +1,58 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <QHash>
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector>
+
+#include "mesh.h"
+#include "scenenode.h"
+
+/**
+ * @brief Hardware occlusion culling for heavy meshes.
+ *
+ * Every frame, the bounding box of each heavy mesh is drawn inside a
+ * GL_ANY_SAMPLES_PASSED query, with color and depth writes disabled. Meshes
+ * that were visible in the previous frame are drawn directly and act as
+ * occluders; the others are drawn under conditional rendering on this frame's
+ * query, so the GPU skips them if no sample of their proxy passed. Results are
+ * double buffered per node, so reading them back never stalls.
+ */
+class OcclusionCuller {
+ public:
+  // Meshes with fewer vertices than this are always drawn, a query costs more
+  static constexpr int minVertexCount = 1024;
+
+  void initialize(QOpenGLFunctions_3_3_Core *functions);
+  void destroy();
+
+  void beginFrame(const QVector<SceneNode *> &drawables,
+                  const QVector<Mesh> &meshes, QVector<SceneNode *> &visible,
+                  QVector<SceneNode *> &deferred);
+  void issueQueries(GLint modelLocation, const QMatrix4x4 &view, float nearPlane);
+
+  void beginConditional(SceneNode *node);
+  void endConditional(SceneNode *node);
+
+ private:
+  struct QueryState {
+    GLuint queries[2] = {0, 0};
+    bool issued[2] = {false, false};
+    bool visible = true;
+  };
+
+  QueryState &stateFor(SceneNode *node);
+
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+  QHash<SceneNode *, QueryState> states;
+  QVector<SceneNode *> queried;
+  int frame = 0;
+
+  // Unit cube used as bounding box proxy
+  GLuint cubeVBO = 0;
+  GLuint cubeEBO = 0;
+  GLuint cubeVAO = 0;
+};
+
+#endif  // OCCLUSIONCULLER_H
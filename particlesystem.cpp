@@ -0,0 +1,150 @@
+#include "particlesystem.h"
+
+#include <QVector>
+
+/**
+ * @brief ParticleSystem::initialize Creates the particle buffers and programs.
+ * All particles start dead and are born over the first lifetime.
+ * @param gl OpenGL functions of the current context.
+ * @param count Number of particles.
+ */
+void ParticleSystem::initialize(QOpenGLFunctions_3_3_Core *gl, int count) {
+  this->count = count;
+
+  updateProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                        ":/shaders/particleupdatevertshader.glsl");
+  const char *varyings[] = {"outPosition", "outVelocity"};
+  gl->glTransformFeedbackVaryings(updateProgram.programId(), 2, varyings,
+                                  GL_INTERLEAVED_ATTRIBS);
+  updateProgram.link();
+
+  drawProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                      ":/shaders/particlevertshader.glsl");
+  drawProgram.addShaderFromSourceFile(QOpenGLShader::Fragment,
+                                      ":/shaders/particlefragshader.glsl");
+  drawProgram.link();
+
+  // Position and age, velocity and lifetime; zero lifetime means dead
+  QVector<GLfloat> initial(8 * count, 0.0f);
+  gl->glGenBuffers(2, buffers);
+  for (GLuint buffer : buffers) {
+    gl->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    gl->glBufferData(GL_ARRAY_BUFFER, initial.size() * sizeof(GLfloat),
+                     initial.constData(), GL_DYNAMIC_COPY);
+  }
+}
+
+/**
+ * @brief ParticleSystem::destroy Deletes the particle buffers.
+ * @param gl OpenGL functions of a current context of the group.
+ */
+void ParticleSystem::destroy(QOpenGLFunctions_3_3_Core *gl) {
+  gl->glDeleteBuffers(2, buffers);
+  count = 0;
+}
+
+/**
+ * @brief ParticleSystem::createVertexArrays Creates vertex arrays of the
+ * calling context reading the particle buffers.
+ * @param gl OpenGL functions of the current context.
+ * @param vertexArrays Receives one vertex array per buffer, to be deleted by
+ * the caller.
+ */
+void ParticleSystem::createVertexArrays(QOpenGLFunctions_3_3_Core *gl,
+                                        GLuint vertexArrays[2]) const {
+  gl->glGenVertexArrays(2, vertexArrays);
+  for (int i = 0; i < 2; i++) {
+    gl->glBindVertexArray(vertexArrays[i]);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+    gl->glEnableVertexAttribArray(0);
+    gl->glEnableVertexAttribArray(1);
+    gl->glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat),
+                              nullptr);
+    gl->glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat),
+                              (void *)(4 * sizeof(GLfloat)));
+  }
+  gl->glBindVertexArray(0);
+}
+
+/**
+ * @brief ParticleSystem::update Advances the simulation by the time since the
+ * last update, from the current buffer into the other one. Only the first
+ * call in a frame of the group simulates.
+ * @param gl OpenGL functions of the current context.
+ * @param vertexArrays Vertex arrays of the current context reading the buffers.
+ * @param frame Frame of the group.
+ */
+void ParticleSystem::update(QOpenGLFunctions_3_3_Core *gl,
+                            const GLuint vertexArrays[2], quint64 frame) {
+  float deltaTime = 0.0f;
+  if (!clock.isValid()) {
+    clock.start();
+  } else if (frame != simulatedFrame) {
+    deltaTime = qMin(clock.restart() / 1000.0f, maxStep);
+  } else {
+    return;
+  }
+  simulatedFrame = frame;
+  time += deltaTime;
+  int next = 1 - current;
+
+  updateProgram.bind();
+  updateProgram.setUniformValue("deltaTime", deltaTime);
+  updateProgram.setUniformValue("time", time);
+  updateProgram.setUniformValue("emitterPosition", emitter.position);
+  updateProgram.setUniformValue("emitterDirection",
+                                emitter.direction.normalized());
+  updateProgram.setUniformValue("spread", emitter.spread);
+  updateProgram.setUniformValue("speed", emitter.speed);
+  updateProgram.setUniformValue("lifetime", emitter.lifetime);
+  updateProgram.setUniformValue("gravity", emitter.gravity);
+  updateProgram.setUniformValue("wind", emitter.wind);
+  updateProgram.setUniformValue("drag", emitter.drag);
+  updateProgram.setUniformValue("floorHeight", emitter.floorHeight);
+
+  gl->glEnable(GL_RASTERIZER_DISCARD);
+  gl->glBindVertexArray(vertexArrays[current]);
+  gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[next]);
+  gl->glBeginTransformFeedback(GL_POINTS);
+  gl->glDrawArrays(GL_POINTS, 0, count);
+  gl->glEndTransformFeedback();
+  gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  gl->glBindVertexArray(0);
+  gl->glDisable(GL_RASTERIZER_DISCARD);
+  updateProgram.release();
+
+  current = next;
+}
+
+/**
+ * @brief ParticleSystem::draw Draws the living particles as additive point
+ * sprites, tested against but not written to the depth buffer.
+ * @param gl OpenGL functions of the current context.
+ * @param vertexArrays Vertex arrays of the current context reading the buffers.
+ * @param projection Projection transformation of the view.
+ * @param view View transformation.
+ * @param pointScale Size of a particle in pixels at clip w of 1: at unit
+ * distance in a perspective view, everywhere in an orthographic one.
+ */
+void ParticleSystem::draw(QOpenGLFunctions_3_3_Core *gl,
+                          const GLuint vertexArrays[2],
+                          const QMatrix4x4 &projection, const QMatrix4x4 &view,
+                          float pointScale) {
+  drawProgram.bind();
+  drawProgram.setUniformValue("projectionTransform", projection);
+  drawProgram.setUniformValue("viewTransform", view);
+  drawProgram.setUniformValue("pointScale", pointScale);
+
+  gl->glEnable(GL_PROGRAM_POINT_SIZE);
+  gl->glEnable(GL_BLEND);
+  gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+  gl->glDepthMask(GL_FALSE);
+  gl->glBindVertexArray(vertexArrays[current]);
+  gl->glDrawArrays(GL_POINTS, 0, count);
+  gl->glBindVertexArray(0);
+  gl->glDepthMask(GL_TRUE);
+  gl->glDisable(GL_BLEND);
+  gl->glDisable(GL_PROGRAM_POINT_SIZE);
+
+  drawProgram.release();
+}
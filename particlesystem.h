@@ -0,0 +1,80 @@
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector3D>
+
+// Defining where particles are born and the forces acting on them, in world
+// space
+struct ParticleEmitter {
+  QVector3D position{0, -2.5f, -6};
+  QVector3D direction{0, 1, 0};
+  float spread = 0.35f;  // radians
+  float speed = 3.0f;
+  float lifetime = 3.0f;  // seconds, on average
+
+  QVector3D gravity{0, -2.5f, 0};
+  QVector3D wind{0.4f, 0, 0};
+  float drag = 0.3f;
+  float floorHeight = -2.6f;  // particles bounce off this plane
+};
+
+/**
+ * @brief Particle system simulated and drawn entirely on the GPU.
+ *
+ * Positions with their age and velocities with their lifetime are kept in two
+ * vertex buffers. Every frame, one is read as vertex attributes by an update
+ * program whose outputs are captured with transform feedback into the other,
+ * with rasterization disabled; the buffers then swap roles. Dead particles are
+ * respawned at the emitter by the same program, at a rate that keeps the
+ * population steady, with random numbers hashed from the particle index and
+ * the time. The emitter and the forces are uniforms, so after the buffers are
+ * created no particle data crosses the bus; drawing reads the freshly written
+ * buffer as point sprites.
+ *
+ * Every view reads the buffers through vertex arrays of its own, created with
+ * createVertexArrays(). The first view drawing in a frame of the group
+ * advances the simulation, the others draw the same state.
+ */
+class ParticleSystem {
+ public:
+  // Longest time simulated in one step; longer pauses are not caught up
+  static constexpr float maxStep = 0.05f;  // seconds
+
+  void initialize(QOpenGLFunctions_3_3_Core *gl, int count);
+  void destroy(QOpenGLFunctions_3_3_Core *gl);
+  void createVertexArrays(QOpenGLFunctions_3_3_Core *gl,
+                          GLuint vertexArrays[2]) const;
+
+  void setEmitter(const ParticleEmitter &emitter) { this->emitter = emitter; }
+  const ParticleEmitter &getEmitter() const { return emitter; }
+  int getCount() const { return count; }
+  qint64 getAllocatedBytes() const { return qint64(count) * 2 * 8 * 4; }
+
+  void update(QOpenGLFunctions_3_3_Core *gl, const GLuint vertexArrays[2],
+              quint64 frame);
+  void draw(QOpenGLFunctions_3_3_Core *gl, const GLuint vertexArrays[2],
+            const QMatrix4x4 &projection, const QMatrix4x4 &view,
+            float pointScale);
+
+ private:
+  int count = 0;
+  ParticleEmitter emitter;
+  float time = 0.0f;  // seconds
+
+  // Frame of the group last simulated, and the time since
+  QElapsedTimer clock;
+  quint64 simulatedFrame = 0;
+
+  // Ping-ponged particle buffers; current holds the latest state
+  GLuint buffers[2] = {};
+  int current = 0;
+
+  QOpenGLShaderProgram updateProgram;
+  QOpenGLShaderProgram drawProgram;
+};
+
+#endif  // PARTICLESYSTEM_H
@@ -0,0 +1,277 @@
+#include "postchain.h"
+
+#include <QFile>
+
+namespace {
+
+// Snippet defining each per-pixel effect, and the function it defines
+struct EffectSource {
+  const char *file;
+  const char *function;
+};
+
+const EffectSource effectSources[] = {
+    {":/shaders/postambientocclusion.glsl", "ambientOcclusion"},
+    {":/shaders/posttonemap.glsl", "tonemap"},
+    {":/shaders/postcolorgrade.glsl", "colorGrade"},
+    {":/shaders/postvignette.glsl", "vignetteEffect"},
+};
+
+QString readSource(const QString &fileName) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    qDebug() << ":: Could not open" << fileName;
+    return QString();
+  }
+  return QString::fromUtf8(file.readAll());
+}
+
+}  // namespace
+
+/**
+ * @brief PostChain::Shared::initialize Compiles the programs of the effects
+ * that are not fused.
+ */
+void PostChain::Shared::initialize() {
+  occlusionProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                           ":/shaders/depthviewvertshader.glsl");
+  occlusionProgram.addShaderFromSourceFile(
+      QOpenGLShader::Fragment, ":/shaders/postocclusionfragshader.glsl");
+  occlusionProgram.link();
+
+  sharpenProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                         ":/shaders/depthviewvertshader.glsl");
+  sharpenProgram.addShaderFromSourceFile(QOpenGLShader::Fragment,
+                                         ":/shaders/postsharpenfragshader.glsl");
+  sharpenProgram.link();
+}
+
+/**
+ * @brief PostChain::Shared::destroy Deletes the generated programs.
+ */
+void PostChain::Shared::destroy() {
+  qDeleteAll(fusedPrograms);
+  fusedPrograms.clear();
+}
+
+/**
+ * @brief PostChain::initialize Creates the vertex array of the full-screen
+ * quad in the current context.
+ * @param functions OpenGL functions of the current context.
+ * @param shared Programs of the context group.
+ */
+void PostChain::initialize(QOpenGLFunctions_3_3_Core *functions,
+                           Shared *shared) {
+  gl = functions;
+  this->shared = shared;
+  gl->glGenVertexArrays(1, &quadVAO);
+}
+
+/**
+ * @brief PostChain::destroy Deletes the vertex array of the quad.
+ */
+void PostChain::destroy() {
+  if (!gl) return;
+  stages.clear();
+  gl->glDeleteVertexArrays(1, &quadVAO);
+  gl = nullptr;
+}
+
+/**
+ * @brief PostChain::setProjection Sets the projection the scene is drawn with,
+ * which the ambient occlusion uses to linearize the depth and to size its
+ * samples on screen.
+ * @param projection Perspective or orthographic projection of the scene.
+ */
+void PostChain::setProjection(const QMatrix4x4 &projection) {
+  focalLength = QVector2D(0.5f * projection(0, 0), 0.5f * projection(1, 1));
+
+  // The planes follow from the third row of either kind of projection
+  float a = projection(2, 2);
+  float b = projection(2, 3);
+  settings.orthographic = projection(3, 3) == 1.0f;
+  if (settings.orthographic) {
+    settings.nearPlane = (b + 1.0f) / a;
+    settings.farPlane = (b - 1.0f) / a;
+  } else {
+    settings.nearPlane = b / (a - 1.0f);
+    settings.farPlane = b / (a + 1.0f);
+  }
+}
+
+/**
+ * @brief PostChain::setEffects Builds the stages for a list of effects, fusing
+ * every run of adjacent per-pixel effects into one stage.
+ * @param effects Effects in the order they are applied.
+ */
+void PostChain::setEffects(const QVector<Effect> &effects) {
+  stages.clear();
+  occlusion = effects.contains(AmbientOcclusion);
+
+  QVector<Effect> run;
+  for (Effect effect : effects) {
+    if (isPerPixel(effect)) {
+      run.append(effect);
+      continue;
+    }
+    if (!run.isEmpty()) stages.append({run, shared->fusedProgram(run)});
+    run.clear();
+    stages.append({{effect}, &shared->sharpenProgram});
+  }
+  // Without effects, a single stage copies the scene to the output
+  if (!run.isEmpty() || stages.isEmpty()) {
+    stages.append({run, shared->fusedProgram(run)});
+  }
+
+  qDebug() << ":: Post-processing" << effects.size() << "effects in"
+           << stages.size() << "passes";
+}
+
+/**
+ * @brief PostChain::Shared::fusedProgram Returns the program applying a run of
+ * per-pixel effects in one pass, generating and compiling it on first use.
+ * @param effects Per-pixel effects in the order they are applied.
+ * @return The program, owned by the shared programs.
+ */
+QOpenGLShaderProgram *PostChain::Shared::fusedProgram(
+    const QVector<Effect> &effects) {
+  QString key;
+  for (Effect effect : effects) key += QString::number(effect) + ",";
+  if (fusedPrograms.contains(key)) return fusedPrograms[key];
+
+  QString source =
+      "#version 330 core\n\n"
+      "// Generated by PostChain\n\n"
+      "in vec2 texCoords;\n"
+      "uniform sampler2D inputTexture;\n"
+      "out vec4 fColor;\n\n";
+  QString body = "  vec3 color = texture(inputTexture, texCoords).rgb;\n";
+  QVector<Effect> included;
+  for (Effect effect : effects) {
+    const EffectSource &effectSource = effectSources[effect];
+    if (!included.contains(effect)) {
+      source += readSource(effectSource.file) + "\n";
+      included.append(effect);
+    }
+    body += QString("  color = %1(color);\n").arg(effectSource.function);
+  }
+  source += "void main() {\n" + body + "  fColor = vec4(color, 1.0F);\n}\n";
+
+  auto *program = new QOpenGLShaderProgram();
+  program->addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                   ":/shaders/depthviewvertshader.glsl");
+  program->addShaderFromSourceCode(QOpenGLShader::Fragment, source);
+  if (!program->link()) qDebug() << ":: Fused post-processing shader:" << source;
+
+  fusedPrograms[key] = program;
+  return program;
+}
+
+/**
+ * @brief PostChain::addPasses Adds the ambient occlusion and one pass per
+ * stage to a render graph.
+ * @param graph The graph, which must outlive its execution.
+ * @param color Scene color, in a floating-point texture.
+ * @param depth Scene depth.
+ * @param output Texture or framebuffer receiving the final image.
+ * @return The version of the output written by the last stage.
+ */
+RenderGraph::Resource PostChain::addPasses(RenderGraph &graph,
+                                           RenderGraph::Resource color,
+                                           RenderGraph::Resource depth,
+                                           RenderGraph::Resource output) {
+  RenderGraph *frameGraph = &graph;
+  int width = graph.getWidth(color);
+  int height = graph.getHeight(color);
+
+  RenderGraph::Resource occlusionTexture = -1;
+  if (occlusion) {
+    int divisor = settings.occlusionDivisor;
+    occlusionTexture = graph.createTexture(
+        "ambient occlusion",
+        {qMax(width / divisor, 1), qMax(height / divisor, 1), GL_RG16F});
+    int pass = graph.addPass("ambient occlusion", [this, frameGraph, depth] {
+      gl->glActiveTexture(GL_TEXTURE1);
+      gl->glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(depth));
+      gl->glActiveTexture(GL_TEXTURE0);
+      QOpenGLShaderProgram *program = &shared->occlusionProgram;
+      program->bind();
+      program->setUniformValue("focalLength", focalLength);
+      drawQuad(program);
+    });
+    graph.read(pass, depth);
+    occlusionTexture = graph.write(pass, occlusionTexture, RenderGraph::DontCare);
+  }
+
+  // Every stage overwrites all of its target, so nothing is cleared
+  RenderGraph::Resource input = color;
+  for (int i = 0; i < stages.size(); i++) {
+    const Stage &stage = stages[i];
+    bool last = i == stages.size() - 1;
+    bool occluded = stage.effects.contains(AmbientOcclusion);
+    RenderGraph::Resource target =
+        last ? output
+             : graph.createTexture(QString("post %1").arg(i),
+                                   {width, height, GL_RGBA16F});
+
+    QOpenGLShaderProgram *program = stage.program;
+    int pass = graph.addPass(
+        QString("post %1").arg(i),
+        [this, frameGraph, program, input, depth, occlusionTexture, occluded] {
+          if (occluded) {
+            gl->glActiveTexture(GL_TEXTURE1);
+            gl->glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(depth));
+            gl->glActiveTexture(GL_TEXTURE2);
+            gl->glBindTexture(GL_TEXTURE_2D,
+                              frameGraph->getTexture(occlusionTexture));
+            gl->glActiveTexture(GL_TEXTURE0);
+          }
+          gl->glBindTexture(GL_TEXTURE_2D, frameGraph->getTexture(input));
+          program->bind();
+          drawQuad(program);
+        });
+    graph.read(pass, input);
+    if (occluded) {
+      graph.read(pass, depth);
+      graph.read(pass, occlusionTexture);
+    }
+    input = graph.write(pass, target, RenderGraph::DontCare);
+  }
+  return input;
+}
+
+/**
+ * @brief PostChain::setUniforms Sets the settings on a bound program. Uniforms
+ * the program does not use are ignored.
+ * @param program The program.
+ */
+void PostChain::setUniforms(QOpenGLShaderProgram *program) {
+  program->setUniformValue("inputTexture", 0);
+  program->setUniformValue("depthTexture", 1);
+  program->setUniformValue("occlusionTexture", 2);
+  program->setUniformValue("nearPlane", settings.nearPlane);
+  program->setUniformValue("farPlane", settings.farPlane);
+  program->setUniformValue("orthographic", GLint(settings.orthographic));
+  program->setUniformValue("occlusionRadius", settings.occlusionRadius);
+  program->setUniformValue("occlusionStrength", settings.occlusionStrength);
+  program->setUniformValue("exposure", settings.exposure);
+  program->setUniformValue("saturation", settings.saturation);
+  program->setUniformValue("contrast", settings.contrast);
+  program->setUniformValue("tint", settings.tint);
+  program->setUniformValue("vignette", settings.vignette);
+  program->setUniformValue("sharpen", settings.sharpen);
+}
+
+/**
+ * @brief PostChain::drawQuad Draws the full-screen quad, generated in the
+ * vertex shader, with a bound program, which is released afterwards.
+ * @param program The program.
+ */
+void PostChain::drawQuad(QOpenGLShaderProgram *program) {
+  setUniforms(program);
+  gl->glDisable(GL_DEPTH_TEST);
+  gl->glBindVertexArray(quadVAO);
+  gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  gl->glEnable(GL_DEPTH_TEST);
+  program->release();
+}
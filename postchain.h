@@ -0,0 +1,108 @@
+#ifndef POSTCHAIN_H
+#define POSTCHAIN_H
+
+#include <QHash>
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector>
+
+#include "rendergraph.h"
+
+// Defining the parameters of the post-processing effects
+struct PostSettings {
+  // Taken from the projection of the scene
+  float nearPlane = 0.2f;
+  float farPlane = 20.0f;
+  bool orthographic = false;
+
+  // Ambient occlusion, computed at 1 / occlusionDivisor of the resolution
+  int occlusionDivisor = 2;
+  float occlusionRadius = 0.5f;  // view space units
+  float occlusionStrength = 1.0f;
+
+  float exposure = 1.0f;
+  float saturation = 1.1f;
+  float contrast = 1.05f;
+  QVector3D tint{1.0f, 0.98f, 0.95f};
+  float vignette = 0.35f;
+  float sharpen = 0.5f;
+};
+
+/**
+ * @brief Chain of full-screen effects applied to the rendered scene.
+ *
+ * The scene is drawn into a floating-point texture. Effects that only look at
+ * their own pixel (ambient occlusion, tonemapping, color grading, vignette)
+ * are fused: adjacent ones are concatenated into one generated fragment
+ * shader, so they cost a single full-screen read and write together. Effects
+ * that read neighboring pixels (sharpening) end a fused stage. Every stage is
+ * added to a render graph as a pass writing a transient texture, which the
+ * graph aliases with the textures of earlier stages once they have been read;
+ * the last stage writes the output directly.
+ *
+ * Ambient occlusion is computed at half or quarter resolution before the
+ * stages, and brought back to full resolution with a depth-aware bilateral
+ * upsample inside the fused stage that applies it.
+ *
+ * The programs are kept in PostChain::Shared; every view has its own chain
+ * with the settings of its projection.
+ */
+class PostChain {
+ public:
+  enum Effect { AmbientOcclusion, Tonemap, ColorGrade, Vignette, Sharpen };
+
+  // Programs of all views
+  class Shared {
+   public:
+    void initialize();
+    void destroy();
+
+   private:
+    friend class PostChain;
+
+    QOpenGLShaderProgram *fusedProgram(const QVector<Effect> &effects);
+
+    // Generated programs, keyed by the effects they fuse
+    QHash<QString, QOpenGLShaderProgram *> fusedPrograms;
+    QOpenGLShaderProgram occlusionProgram;
+    QOpenGLShaderProgram sharpenProgram;
+  };
+
+  void initialize(QOpenGLFunctions_3_3_Core *functions, Shared *shared);
+  void destroy();
+  void setProjection(const QMatrix4x4 &projection);
+
+  void setEffects(const QVector<Effect> &effects);
+  PostSettings &getSettings() { return settings; }
+
+  RenderGraph::Resource addPasses(RenderGraph &graph,
+                                  RenderGraph::Resource color,
+                                  RenderGraph::Resource depth,
+                                  RenderGraph::Resource output);
+
+  int getStageCount() const { return stages.size(); }
+
+ private:
+  struct Stage {
+    QVector<Effect> effects;
+    QOpenGLShaderProgram *program;
+  };
+
+  static bool isPerPixel(Effect effect) { return effect != Sharpen; }
+  void setUniforms(QOpenGLShaderProgram *program);
+  void drawQuad(QOpenGLShaderProgram *program);
+
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+  Shared *shared = nullptr;
+  PostSettings settings;
+  QVector2D focalLength{1.0f, 1.0f};
+
+  bool occlusion = false;
+  QVector<Stage> stages;
+  GLuint quadVAO = 0;
+};
+
+#endif  // POSTCHAIN_H
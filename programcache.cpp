@@ -0,0 +1,157 @@
+#include "programcache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QStandardPaths>
+#include <cstring>
+
+#include "assetwatcher.h"
+
+/**
+ * @brief ProgramCache::loadSource Reads a shader source, resolved through
+ * AssetWatcher::resolve(), and inserts lines after its #version line, which
+ * must come first.
+ * @param path Path of the source.
+ * @param header Lines to insert.
+ * @return Source with the lines, empty if the file could not be read.
+ */
+QByteArray ProgramCache::loadSource(const QString &path,
+                                    const QByteArray &header) {
+  QFile file(AssetWatcher::resolve(path));
+  if (!file.open(QIODevice::ReadOnly)) {
+    qDebug() << ":: Could not open" << path;
+    return QByteArray();
+  }
+  QByteArray source = file.readAll();
+  if (header.isEmpty()) return source;
+  int lineEnd = source.startsWith("#version") ? source.indexOf('\n') + 1 : 0;
+  return source.left(lineEnd) + header + source.mid(lineEnd);
+}
+
+/**
+ * @brief ProgramCache::initialize Checks for program binary support and
+ * creates the cache directory. Called on the first build.
+ */
+void ProgramCache::initialize() {
+  initialized = true;
+
+  QOpenGLContext *context = QOpenGLContext::currentContext();
+  QOpenGLExtraFunctions *gl = context->extraFunctions();
+  GLint formats = 0;
+  if (context->format().version() >= qMakePair(4, 1) ||
+      context->hasExtension("GL_ARB_get_program_binary")) {
+    gl->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  }
+  supported = formats > 0;
+  if (!supported) {
+    qDebug() << ":: Program binaries not supported, compiling from source";
+    return;
+  }
+
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    driver += reinterpret_cast<const char *>(gl->glGetString(name));
+    driver += '\n';
+  }
+  directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+              "/programs";
+  QDir().mkpath(directory);
+}
+
+/**
+ * @brief ProgramCache::build Links a program from its cached binary, or from
+ * source if there is none, storing the binary for the next time.
+ * @param program Program to build, without shaders.
+ * @param stages Shader stages and the paths of their sources.
+ * @param defines Lines prepended to every stage, after the #version line.
+ * @return Whether the program linked.
+ */
+bool ProgramCache::build(QOpenGLShaderProgram &program,
+                         const QVector<Stage> &stages,
+                         const QByteArray &defines) {
+  if (!initialized) initialize();
+
+  QVector<QByteArray> sources;
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(driver);
+  hash.addData(defines);
+  for (const Stage &stage : stages) {
+    sources.append(loadSource(stage.path, defines + stage.header));
+    if (sources.last().isEmpty()) return false;
+    hash.addData(QByteArray::number(stage.type.toInt()));
+    hash.addData(sources.last());
+  }
+
+  QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+  program.create();
+  QString path = directory + "/" + hash.result().toHex() + ".bin";
+
+  // The stored binary starts with its format; with no shaders attached,
+  // link() only takes over the link status of the loaded binary
+  QFile cached(path);
+  if (supported && cached.open(QIODevice::ReadOnly)) {
+    QByteArray binary = cached.readAll();
+    cached.close();
+    if (binary.size() > int(sizeof(GLenum))) {
+      GLenum format;
+      memcpy(&format, binary.constData(), sizeof(GLenum));
+      gl->glProgramBinary(program.programId(), format,
+                          binary.constData() + sizeof(GLenum),
+                          binary.size() - sizeof(GLenum));
+      if (program.link()) {
+        hits++;
+        return true;
+      }
+    }
+    qDebug() << ":: Discarding invalid program binary" << path;
+    QFile::remove(path);
+  }
+
+  misses++;
+  for (int i = 0; i < stages.size(); i++) {
+    program.addShaderFromSourceCode(stages[i].type, sources[i]);
+  }
+  if (supported) {
+    gl->glProgramParameteri(program.programId(),
+                            GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  if (!program.link()) return false;
+
+  if (supported) {
+    GLint length = 0;
+    gl->glGetProgramiv(program.programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+    QByteArray binary(sizeof(GLenum) + length, Qt::Uninitialized);
+    GLenum format = 0;
+    gl->glGetProgramBinary(program.programId(), length, &length, &format,
+                           binary.data() + sizeof(GLenum));
+    memcpy(binary.data(), &format, sizeof(GLenum));
+    binary.resize(sizeof(GLenum) + length);
+    if (length > 0 && cached.open(QIODevice::WriteOnly)) cached.write(binary);
+  }
+  return true;
+}
+
+/**
+ * @brief ProgramCache::rebuild Builds a program again from changed sources.
+ * The sources are compiled into a scratch program first, so a program whose
+ * new sources do not compile keeps working with the old ones.
+ * @param program Linked program to replace.
+ * @param stages Shader stages and the paths of their sources.
+ * @param defines Lines prepended to every stage, after the #version line.
+ * @return Whether the program was replaced.
+ */
+bool ProgramCache::rebuild(QOpenGLShaderProgram &program,
+                           const QVector<Stage> &stages,
+                           const QByteArray &defines) {
+  QOpenGLShaderProgram scratch;
+  if (!build(scratch, stages, defines)) {
+    qDebug() << ":: Keeping the previous program";
+    return false;
+  }
+
+  // Loaded from the binary the scratch build stored, where supported
+  program.removeAllShaders();
+  return build(program, stages, defines);
+}
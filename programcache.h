@@ -0,0 +1,56 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <QByteArray>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Builds shader programs, reusing program binaries stored on disk.
+ *
+ * Where GL_ARB_get_program_binary (core in 4.1) is available, the binary of
+ * every program linked from source is written to the cache directory, named
+ * by a hash of the sources of its stages, the defines prepended to them and
+ * the vendor, renderer and version strings of the driver. The next build of
+ * the same program loads that binary instead of compiling. A binary the
+ * driver rejects, for example after an update that kept the version string,
+ * is deleted and the program compiled from source again.
+ *
+ * Sources are read through AssetWatcher::resolve(), from the source tree in
+ * development mode, where rebuild() replaces a program after an edit.
+ */
+class ProgramCache {
+ public:
+  // The header is inserted after the #version line of this stage only, for
+  // example the vertex inputs declared by a VertexFormat
+  struct Stage {
+    QOpenGLShader::ShaderType type;
+    QString path;
+    QByteArray header;
+  };
+
+  static QByteArray loadSource(const QString &path,
+                               const QByteArray &header = QByteArray());
+
+  bool build(QOpenGLShaderProgram &program, const QVector<Stage> &stages,
+             const QByteArray &defines = QByteArray());
+  bool rebuild(QOpenGLShaderProgram &program, const QVector<Stage> &stages,
+               const QByteArray &defines = QByteArray());
+
+  int getHits() const { return hits; }
+  int getMisses() const { return misses; }
+
+ private:
+  void initialize();
+
+  bool initialized = false;
+  bool supported = false;
+  QByteArray driver;  // vendor, renderer and version strings
+  QString directory;
+
+  int hits = 0;
+  int misses = 0;
+};
+
+#endif  // PROGRAMCACHE_H
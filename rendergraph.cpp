@@ -0,0 +1,410 @@
+#include "rendergraph.h"
+
+/**
+ * @brief RenderGraph::initialize Stores the OpenGL functions; textures and
+ * framebuffers are created on demand.
+ * @param functions OpenGL functions of the current context.
+ */
+void RenderGraph::initialize(QOpenGLFunctions_3_3_Core *functions) {
+  gl = functions;
+  pool.initialize(gl);
+}
+
+/**
+ * @brief RenderGraph::destroy Deletes the pooled textures and framebuffers.
+ */
+void RenderGraph::destroy() {
+  if (!gl) return;
+  reset();
+  for (GLuint framebuffer : framebuffers) gl->glDeleteFramebuffers(1, &framebuffer);
+  framebuffers.clear();
+  pool.destroy();
+  gl = nullptr;
+}
+
+/**
+ * @brief RenderGraph::reset Forgets the passes and resources of the previous
+ * frame. Pooled textures are kept for reuse.
+ */
+void RenderGraph::reset() {
+  textures.clear();
+  resources.clear();
+  passes.clear();
+  order.clear();
+}
+
+/**
+ * @brief RenderGraph::createTexture Declares a transient texture, only
+ * allocated while passes use it.
+ * @param name Name of the texture, used for debugging.
+ * @param desc Size and format.
+ * @return The first version of the texture, with undefined contents.
+ */
+RenderGraph::Resource RenderGraph::createTexture(const QString &name,
+                                                 const TextureDesc &desc) {
+  TextureNode texture;
+  texture.name = name;
+  texture.desc = desc;
+  texture.lastVersion = resources.size();
+  textures.append(texture);
+  resources.append({textures.size() - 1, -1});
+  return resources.size() - 1;
+}
+
+/**
+ * @brief RenderGraph::importTexture Declares a texture owned outside of the
+ * graph, whose contents persist between frames.
+ * @param name Name of the texture, used for debugging.
+ * @param texture The texture.
+ * @param framebuffer Framebuffer the texture is attached to.
+ * @param width Width in pixels.
+ * @param height Height in pixels.
+ * @return The current version of the texture.
+ */
+RenderGraph::Resource RenderGraph::importTexture(const QString &name,
+                                                 GLuint texture,
+                                                 GLuint framebuffer, int width,
+                                                 int height) {
+  Resource resource = createTexture(name, {width, height, GL_NONE});
+  TextureNode &node = textures.last();
+  node.imported = true;
+  node.texture = texture;
+  node.framebuffer = framebuffer;
+  return resource;
+}
+
+/**
+ * @brief RenderGraph::importFramebuffer Declares the color and depth of a
+ * framebuffer owned outside of the graph, such as the one shown on screen. The
+ * last version of its color is an output of the graph.
+ * @param name Name of the framebuffer, used for debugging.
+ * @param framebuffer The framebuffer.
+ * @param width Width in pixels.
+ * @param height Height in pixels.
+ * @param color Set to the color of the framebuffer.
+ * @param depth Set to the depth of the framebuffer.
+ */
+void RenderGraph::importFramebuffer(const QString &name, GLuint framebuffer,
+                                    int width, int height, Resource &color,
+                                    Resource &depth) {
+  color = importTexture(name + " color", 0, framebuffer, width, height);
+  textures.last().output = true;
+  depth = importTexture(name + " depth", 0, framebuffer, width, height);
+  textures.last().desc.format = GL_DEPTH_COMPONENT24;
+}
+
+/**
+ * @brief RenderGraph::addPass Declares a pass. Its reads and writes are
+ * declared afterwards.
+ * @param name Name of the pass, used for debugging.
+ * @param execute Issues the pass's commands. The targets it writes are bound,
+ * with the viewport covering them.
+ * @return Index of the pass.
+ */
+int RenderGraph::addPass(const QString &name,
+                         const std::function<void()> &execute) {
+  PassNode pass;
+  pass.name = name;
+  pass.execute = execute;
+  passes.append(pass);
+  return passes.size() - 1;
+}
+
+/**
+ * @brief RenderGraph::read Declares that a pass samples a texture.
+ * @param pass Index of the pass.
+ * @param resource Version of the texture that is read.
+ */
+void RenderGraph::read(int pass, Resource resource) {
+  passes[pass].reads.append(resource);
+  resources[resource].readers.append(pass);
+}
+
+/**
+ * @brief RenderGraph::write Declares that a pass renders to a texture, which
+ * creates a new version of it.
+ * @param pass Index of the pass.
+ * @param resource Current version of the texture.
+ * @param load Whether the pass keeps, clears or overwrites the contents.
+ * @return The new version, to be used by later passes.
+ */
+RenderGraph::Resource RenderGraph::write(int pass, Resource resource,
+                                         LoadOp load) {
+  int texture = resources[resource].texture;
+  if (load == Load) {
+    // Keeping contents that were never written is the same as not caring
+    bool defined = textures[texture].imported || resources[resource].writer >= 0;
+    if (defined) {
+      read(pass, resource);
+    } else {
+      load = DontCare;
+    }
+  }
+
+  resources.append({texture, resource});
+  Resource version = resources.size() - 1;
+  resources[version].writer = pass;
+  textures[texture].lastVersion = version;
+  passes[pass].writes.append(version);
+  passes[pass].loads.append(load);
+  return version;
+}
+
+/**
+ * @brief RenderGraph::compile Culls the passes that do not contribute to an
+ * output, orders the others and computes the lifetimes of the textures.
+ */
+void RenderGraph::compile() {
+  cull();
+  sort();
+
+  for (TextureNode &texture : textures) {
+    texture.firstUse = -1;
+    texture.lastUse = -1;
+  }
+  for (int i = 0; i < order.size(); i++) {
+    const PassNode &pass = passes[order[i]];
+    for (const QVector<Resource> *list : {&pass.reads, &pass.writes}) {
+      for (Resource resource : *list) {
+        TextureNode &texture = textures[resources[resource].texture];
+        if (texture.firstUse < 0) texture.firstUse = i;
+        texture.lastUse = i;
+      }
+    }
+  }
+}
+
+/**
+ * @brief RenderGraph::cull Marks the passes whose writes are neither read by a
+ * remaining pass nor an output, repeating until nothing changes.
+ */
+void RenderGraph::cull() {
+  QVector<int> resourceRefs(resources.size(), 0);
+  QVector<int> passRefs(passes.size(), 0);
+  for (int r = 0; r < resources.size(); r++) {
+    resourceRefs[r] = resources[r].readers.size();
+  }
+  for (const TextureNode &texture : textures) {
+    if (texture.output) resourceRefs[texture.lastVersion]++;
+  }
+  for (int p = 0; p < passes.size(); p++) {
+    passes[p].culled = false;
+    passRefs[p] = passes[p].writes.size();
+  }
+
+  QVector<int> unreferenced;
+  for (int r = 0; r < resources.size(); r++) {
+    if (resourceRefs[r] == 0) unreferenced.append(r);
+  }
+  while (!unreferenced.isEmpty()) {
+    int writer = resources[unreferenced.last()].writer;
+    unreferenced.removeLast();
+    if (writer < 0 || --passRefs[writer] > 0) continue;
+
+    passes[writer].culled = true;
+    for (Resource resource : passes[writer].reads) {
+      if (--resourceRefs[resource] == 0) unreferenced.append(resource);
+    }
+  }
+
+  // Passes without any write are culled as well
+  for (int p = 0; p < passes.size(); p++) {
+    if (passRefs[p] == 0) passes[p].culled = true;
+  }
+}
+
+/**
+ * @brief RenderGraph::sort Orders the remaining passes so that every pass runs
+ * after the writers of what it reads, and every writer runs after the readers
+ * of the version it replaces. Ties keep the declaration order.
+ */
+void RenderGraph::sort() {
+  QVector<QVector<int>> dependencies(passes.size());
+  for (int p = 0; p < passes.size(); p++) {
+    if (passes[p].culled) continue;
+    for (Resource resource : passes[p].reads) {
+      int writer = resources[resource].writer;
+      if (writer >= 0) dependencies[p].append(writer);
+    }
+    for (Resource resource : passes[p].writes) {
+      int previous = resources[resource].previous;
+      if (previous < 0) continue;
+      for (int reader : resources[previous].readers) {
+        if (reader != p) dependencies[p].append(reader);
+      }
+    }
+  }
+
+  order.clear();
+  QVector<bool> done(passes.size(), false);
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (int p = 0; p < passes.size(); p++) {
+      if (done[p] || passes[p].culled) continue;
+      bool ready = true;
+      for (int dependency : dependencies[p]) {
+        if (!done[dependency] && !passes[dependency].culled) ready = false;
+      }
+      if (!ready) continue;
+      done[p] = true;
+      order.append(p);
+      progress = true;
+      break;
+    }
+  }
+
+  for (int p = 0; p < passes.size(); p++) {
+    if (!done[p] && !passes[p].culled) {
+      qDebug() << ":: Render graph cycle at pass" << passes[p].name;
+    }
+  }
+}
+
+/**
+ * @brief RenderGraph::execute Runs the passes in order. Transient textures are
+ * acquired right before their first use and released after their last.
+ */
+void RenderGraph::execute() {
+  for (int i = 0; i < order.size(); i++) {
+    const PassNode &pass = passes[order[i]];
+
+    for (TextureNode &texture : textures) {
+      if (texture.imported || texture.firstUse != i) continue;
+      texture.target = pool.acquire(texture.desc.width, texture.desc.height,
+                                    texture.desc.format);
+      texture.texture = pool.getTexture(texture.target);
+    }
+
+    if (!pass.writes.isEmpty()) bindTargets(pass);
+    pass.execute();
+
+    for (TextureNode &texture : textures) {
+      if (texture.imported || texture.lastUse != i) continue;
+      pool.release(texture.target);
+    }
+  }
+
+  // Dropping textures that were not needed this frame, and with them the
+  // framebuffers they were attached to
+  if (pool.trim()) {
+    for (GLuint framebuffer : framebuffers) {
+      gl->glDeleteFramebuffers(1, &framebuffer);
+    }
+    framebuffers.clear();
+  }
+  if (pool.getAllocatedBytes() != reportedBytes) {
+    reportedBytes = pool.getAllocatedBytes();
+    qDebug() << ":: Render graph executes" << order.size() << "of"
+             << passes.size() << "passes," << pool.getAllocatedCount()
+             << "targets," << reportedBytes / (1024 * 1024) << "MiB";
+  }
+}
+
+/**
+ * @brief RenderGraph::bindTargets Binds the framebuffer for the writes of a
+ * pass, sets the viewport and clears what the pass asked to clear.
+ * @param pass The pass.
+ */
+void RenderGraph::bindTargets(const PassNode &pass) {
+  GLuint framebuffer = 0;
+  bool importedFramebuffer = false;
+  QVector<GLuint> colors;
+  GLuint depth = 0;
+  GLbitfield clearBits = 0;
+  int width = 0;
+  int height = 0;
+
+  for (int i = 0; i < pass.writes.size(); i++) {
+    const TextureNode &texture = textures[resources[pass.writes[i]].texture];
+    bool isDepth = RenderTargetPool::isDepthFormat(texture.desc.format);
+    width = texture.desc.width;
+    height = texture.desc.height;
+
+    if (texture.imported) {
+      framebuffer = texture.framebuffer;
+      importedFramebuffer = true;
+    } else if (isDepth) {
+      depth = texture.texture;
+    } else {
+      colors.append(texture.texture);
+    }
+    if (pass.loads[i] == Clear) {
+      clearBits |= isDepth ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT;
+    }
+  }
+
+  if (!importedFramebuffer) framebuffer = framebufferFor(colors, depth);
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  gl->glViewport(0, 0, width, height);
+  if (clearBits) {
+    if (clearBits & GL_DEPTH_BUFFER_BIT) gl->glDepthMask(GL_TRUE);
+    gl->glClear(clearBits);
+  }
+}
+
+/**
+ * @brief RenderGraph::framebufferFor Returns a framebuffer with the given
+ * attachments, creating it on first use.
+ * @param colors Color textures, attached in order.
+ * @param depth Depth texture, 0 for none.
+ * @return The framebuffer.
+ */
+GLuint RenderGraph::framebufferFor(const QVector<GLuint> &colors, GLuint depth) {
+  QString key = QString::number(depth);
+  for (GLuint color : colors) key += "," + QString::number(color);
+  if (framebuffers.contains(key)) return framebuffers[key];
+
+  GLuint framebuffer;
+  gl->glGenFramebuffers(1, &framebuffer);
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  QVector<GLenum> drawBuffers;
+  for (int i = 0; i < colors.size(); i++) {
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                               GL_TEXTURE_2D, colors[i], 0);
+    drawBuffers.append(GL_COLOR_ATTACHMENT0 + i);
+  }
+  if (depth) {
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                               GL_TEXTURE_2D, depth, 0);
+  }
+  if (drawBuffers.isEmpty()) {
+    gl->glDrawBuffer(GL_NONE);
+  } else {
+    gl->glDrawBuffers(drawBuffers.size(), drawBuffers.constData());
+  }
+  if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    qDebug() << ":: Render graph framebuffer incomplete";
+  }
+
+  framebuffers[key] = framebuffer;
+  return framebuffer;
+}
+
+/**
+ * @brief RenderGraph::getTexture Returns the texture behind a resource. For a
+ * transient texture, this is only valid while the graph executes.
+ * @param resource Any version of the texture.
+ * @return The texture.
+ */
+GLuint RenderGraph::getTexture(Resource resource) const {
+  return textures[resources[resource].texture].texture;
+}
+
+/**
+ * @brief RenderGraph::getWidth Returns the width of a texture.
+ * @param resource Any version of the texture.
+ * @return Width in pixels.
+ */
+int RenderGraph::getWidth(Resource resource) const {
+  return textures[resources[resource].texture].desc.width;
+}
+
+/**
+ * @brief RenderGraph::getHeight Returns the height of a texture.
+ * @param resource Any version of the texture.
+ * @return Height in pixels.
+ */
+int RenderGraph::getHeight(Resource resource) const {
+  return textures[resources[resource].texture].desc.height;
+}
@@ -0,0 +1,117 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <QHash>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+#include "rendertargetpool.h"
+
+/**
+ * @brief Frame graph that schedules render passes from the textures they read
+ * and write.
+ *
+ * Every frame, passes are declared together with their reads and writes.
+ * Writing a texture creates a new version of it, so every version has exactly
+ * one writer and the dependencies between passes follow directly. Compiling
+ * the graph culls the passes whose results never reach an output, orders the
+ * remaining ones, and derives the lifetime of every transient texture. At
+ * execution, transient textures are taken from a pool when first written and
+ * handed back after their last use, so textures of the same size and format
+ * whose lifetimes do not overlap share one allocation. Clears are only issued
+ * where a pass asks for them on a texture with defined previous contents
+ * being discarded; loading a transient texture that was never written is
+ * skipped.
+ */
+class RenderGraph {
+ public:
+  using Resource = int;
+
+  // What happens to the previous contents of a written texture
+  enum LoadOp { Load, Clear, DontCare };
+
+  struct TextureDesc {
+    int width;
+    int height;
+    GLenum format;
+  };
+
+  void initialize(QOpenGLFunctions_3_3_Core *functions);
+  void destroy();
+  void reset();
+
+  // Resources, valid until the next reset
+  Resource createTexture(const QString &name, const TextureDesc &desc);
+  Resource importTexture(const QString &name, GLuint texture,
+                         GLuint framebuffer, int width, int height);
+  void importFramebuffer(const QString &name, GLuint framebuffer, int width,
+                         int height, Resource &color, Resource &depth);
+
+  // Passes, executed in dependency order
+  int addPass(const QString &name, const std::function<void()> &execute);
+  void read(int pass, Resource resource);
+  Resource write(int pass, Resource resource, LoadOp load = Load);
+
+  void compile();
+  void execute();
+
+  // Only valid while the graph executes
+  GLuint getTexture(Resource resource) const;
+  int getWidth(Resource resource) const;
+  int getHeight(Resource resource) const;
+
+  int getPassCount() const { return passes.size(); }
+  int getExecutedCount() const { return order.size(); }
+  qint64 getAllocatedBytes() const { return pool.getAllocatedBytes(); }
+
+ private:
+  struct TextureNode {
+    QString name;
+    TextureDesc desc;
+    bool imported = false;
+    bool output = false;
+    GLuint texture = 0;
+    GLuint framebuffer = 0;
+    int target = -1;
+    int lastVersion;
+    int firstUse;
+    int lastUse;
+  };
+
+  struct ResourceNode {
+    int texture;
+    int previous;  // version this one replaces, -1 for the first
+    int writer = -1;
+    QVector<int> readers;
+  };
+
+  struct PassNode {
+    QString name;
+    std::function<void()> execute;
+    QVector<Resource> reads;
+    QVector<Resource> writes;
+    QVector<LoadOp> loads;
+    bool culled = false;
+  };
+
+  void cull();
+  void sort();
+  void bindTargets(const PassNode &pass);
+  GLuint framebufferFor(const QVector<GLuint> &colors, GLuint depth);
+
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+  RenderTargetPool pool;
+
+  QVector<TextureNode> textures;
+  QVector<ResourceNode> resources;
+  QVector<PassNode> passes;
+  QVector<int> order;
+
+  // Framebuffers of the transient attachment combinations seen so far
+  QHash<QString, GLuint> framebuffers;
+  qint64 reportedBytes = 0;
+};
+
+#endif  // RENDERGRAPH_H
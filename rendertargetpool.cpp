@@ -0,0 +1,142 @@
+#include "rendertargetpool.h"
+
+/**
+ * @brief RenderTargetPool::initialize Stores the OpenGL functions; targets are
+ * created on demand.
+ * @param functions OpenGL functions of the current context.
+ */
+void RenderTargetPool::initialize(QOpenGLFunctions_3_3_Core *functions) {
+  gl = functions;
+}
+
+/**
+ * @brief RenderTargetPool::destroy Deletes all targets.
+ */
+void RenderTargetPool::destroy() {
+  if (!gl) return;
+  clear();
+  gl = nullptr;
+}
+
+/**
+ * @brief RenderTargetPool::clear Deletes all targets. Previously returned
+ * indices become invalid.
+ */
+void RenderTargetPool::clear() {
+  for (RenderTarget &target : targets) gl->glDeleteTextures(1, &target.texture);
+  targets.clear();
+}
+
+/**
+ * @brief RenderTargetPool::trim Deletes the targets that were not acquired
+ * since the previous trim. Call once per frame, when no target is in use.
+ * @return Whether any target was deleted.
+ */
+bool RenderTargetPool::trim() {
+  QVector<RenderTarget> kept;
+  for (RenderTarget &target : targets) {
+    if (target.used || target.inUse) {
+      target.used = false;
+      kept.append(target);
+    } else {
+      gl->glDeleteTextures(1, &target.texture);
+    }
+  }
+  bool deleted = kept.size() != targets.size();
+  targets = kept;
+  return deleted;
+}
+
+/**
+ * @brief RenderTargetPool::acquire Returns a free target of the given size and
+ * format, creating one only if none was released before.
+ * @param width Width in pixels.
+ * @param height Height in pixels.
+ * @param internalFormat Color or depth format of the texture, e.g. GL_RGBA16F.
+ * @return Index of the target, marked as in use.
+ */
+int RenderTargetPool::acquire(int width, int height, GLenum internalFormat) {
+  for (int i = 0; i < targets.size(); i++) {
+    RenderTarget &target = targets[i];
+    if (!target.inUse && target.width == width && target.height == height &&
+        target.internalFormat == internalFormat) {
+      target.inUse = true;
+      target.used = true;
+      return i;
+    }
+  }
+
+  RenderTarget target;
+  target.width = width;
+  target.height = height;
+  target.internalFormat = internalFormat;
+  target.inUse = true;
+
+  bool depth = isDepthFormat(internalFormat);
+  gl->glGenTextures(1, &target.texture);
+  gl->glBindTexture(GL_TEXTURE_2D, target.texture);
+  gl->glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+                   depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, nullptr);
+  GLint filter = depth ? GL_NEAREST : GL_LINEAR;
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  targets.append(target);
+  return targets.size() - 1;
+}
+
+/**
+ * @brief RenderTargetPool::release Returns a target to the pool, so a later
+ * pass can reuse it.
+ * @param target Index of the target.
+ */
+void RenderTargetPool::release(int target) { targets[target].inUse = false; }
+
+/**
+ * @brief RenderTargetPool::getAllocatedBytes Returns the memory taken by all
+ * targets, in use or not.
+ * @return Size in bytes.
+ */
+qint64 RenderTargetPool::getAllocatedBytes() const {
+  qint64 bytes = 0;
+  for (const RenderTarget &target : targets) {
+    bytes += qint64(target.width) * target.height *
+             bytesPerPixel(target.internalFormat);
+  }
+  return bytes;
+}
+
+/**
+ * @brief RenderTargetPool::isDepthFormat Returns whether a format is attached
+ * as depth rather than color.
+ * @param internalFormat Internal format of a texture.
+ * @return Whether it is a depth format.
+ */
+bool RenderTargetPool::isDepthFormat(GLenum internalFormat) {
+  return internalFormat == GL_DEPTH_COMPONENT16 ||
+         internalFormat == GL_DEPTH_COMPONENT24 ||
+         internalFormat == GL_DEPTH_COMPONENT32F;
+}
+
+/**
+ * @brief RenderTargetPool::bytesPerPixel Returns the size of one pixel of the
+ * formats used for render targets.
+ * @param internalFormat Internal format of a texture.
+ * @return Size in bytes, 4 for unknown formats.
+ */
+int RenderTargetPool::bytesPerPixel(GLenum internalFormat) {
+  switch (internalFormat) {
+    case GL_R8:
+      return 1;
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGBA16F:
+      return 8;
+    case GL_RGBA32F:
+      return 16;
+    default:
+      return 4;
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector>
+
+/**
+ * @brief Pool of textures used as color or depth render targets.
+ *
+ * Passes acquire a texture of a given size and format for as long as they need
+ * it and release it afterwards; a later pass asking for the same size and
+ * format gets the released texture back instead of a new allocation. Textures
+ * not acquired during the last frame, for instance after a resize, are deleted
+ * by trim. Targets are referenced by index, which stays valid until the next
+ * trim or clear.
+ */
+class RenderTargetPool {
+ public:
+  void initialize(QOpenGLFunctions_3_3_Core *functions);
+  void destroy();
+  void clear();
+  bool trim();
+
+  int acquire(int width, int height, GLenum internalFormat);
+  void release(int target);
+
+  GLuint getTexture(int target) const { return targets[target].texture; }
+  int getAllocatedCount() const { return targets.size(); }
+  qint64 getAllocatedBytes() const;
+
+  static bool isDepthFormat(GLenum internalFormat);
+  static int bytesPerPixel(GLenum internalFormat);
+
+ private:
+  struct RenderTarget {
+    GLuint texture = 0;
+    int width;
+    int height;
+    GLenum internalFormat;
+    bool inUse = false;
+    bool used = true;
+  };
+
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+  QVector<RenderTarget> targets;
+};
+
+#endif  // RENDERTARGETPOOL_H
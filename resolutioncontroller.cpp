@@ -0,0 +1,108 @@
+#include "resolutioncontroller.h"
+
+#include <cmath>
+
+namespace {
+
+// Weight of the newest measurement in the smoothed times
+const float smoothing = 0.2f;
+
+// Relative frame time difference that is not acted upon
+const float deadBand = 0.1f;
+
+}  // namespace
+
+/**
+ * @brief ResolutionController::initialize Creates the timer queries.
+ * @param functions OpenGL functions of the current context.
+ */
+void ResolutionController::initialize(QOpenGLFunctions_3_3_Core *functions) {
+  gl = functions;
+  gl->glGenQueries(queryCount, queries);
+}
+
+/**
+ * @brief ResolutionController::destroy Deletes the timer queries.
+ */
+void ResolutionController::destroy() {
+  if (!gl) return;
+  gl->glDeleteQueries(queryCount, queries);
+  gl = nullptr;
+}
+
+/**
+ * @brief ResolutionController::setDevicePixelRatio Updates the bounds of the
+ * scale for a screen. On high-density screens, the scale starts at one scene
+ * pixel per logical pixel.
+ * @param ratio Device pixels per logical pixel.
+ */
+void ResolutionController::setDevicePixelRatio(float ratio) {
+  ratio = std::fmax(ratio, 1.0f);
+  if (ratio == devicePixelRatio) return;
+  devicePixelRatio = ratio;
+  minScale = 0.5f / ratio;
+  scale = 1.0f / ratio;
+}
+
+/**
+ * @brief ResolutionController::setEnabled Switches between the controlled
+ * scale and full resolution.
+ * @param enabled Whether the scale is controlled.
+ */
+void ResolutionController::setEnabled(bool enabled) {
+  this->enabled = enabled;
+}
+
+/**
+ * @brief ResolutionController::beginFrame Starts measuring a frame. Must be
+ * paired with endFrame in the same context.
+ */
+void ResolutionController::beginFrame() {
+  frameTimer.start();
+
+  // The query about to be reused was issued queryCount frames ago, and is
+  // normally available by now; if not, its measurement is skipped
+  if (pending[current]) {
+    GLint available = 0;
+    gl->glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+    if (available) {
+      GLuint64 nanoseconds = 0;
+      gl->glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &nanoseconds);
+      gpuTime += smoothing * (nanoseconds / 1.0e6f - gpuTime);
+      adjust();
+    }
+    pending[current] = false;
+  }
+
+  gl->glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+/**
+ * @brief ResolutionController::endFrame Stops measuring the frame.
+ */
+void ResolutionController::endFrame() {
+  gl->glEndQuery(GL_TIME_ELAPSED);
+  pending[current] = true;
+  current = (current + 1) % queryCount;
+  cpuTime += smoothing * (frameTimer.nsecsElapsed() / 1.0e6f - cpuTime);
+}
+
+/**
+ * @brief ResolutionController::adjust Moves the scale towards the one that
+ * would make the GPU time meet the target.
+ */
+void ResolutionController::adjust() {
+  if (gpuTime <= 0.0f) return;
+  float ratio = targetTime / gpuTime;
+  if (std::fabs(ratio - 1.0f) < deadBand) return;
+  if (ratio < 1.0f && cpuTime > gpuTime) return;
+
+  // Pixel count goes with the square of the scale; only half of the way
+  // is taken per measurement, as the times lag behind
+  float ideal = scale * std::sqrt(ratio);
+  float next = scale + 0.5f * (ideal - scale);
+  next = std::round(next / step) * step;
+  if (next == scale) next = scale + (ratio > 1.0f ? step : -step);
+  scale = std::fmax(std::fmin(next, 1.0f), minScale);
+}
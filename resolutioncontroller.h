@@ -0,0 +1,61 @@
+#ifndef RESOLUTIONCONTROLLER_H
+#define RESOLUTIONCONTROLLER_H
+
+#include <QElapsedTimer>
+#include <QOpenGLFunctions_3_3_Core>
+
+/**
+ * @brief Picks the resolution scale of the scene every frame to hold a frame
+ * time target.
+ *
+ * GPU time is measured with GL_TIME_ELAPSED queries, read back a few frames
+ * later so the CPU never waits for them, and CPU time with a timer around the
+ * frame. Since the cost of the scene scales with its pixel count, the scale
+ * moves towards the square root of the ratio between the target and the GPU
+ * time, damped and with a dead band so it does not oscillate. It is only
+ * lowered if the GPU is the bottleneck; a frame limited by the CPU does not
+ * get faster with fewer pixels.
+ *
+ * Scales are quantized, so the render targets only change size occasionally,
+ * and bounded below relative to the device pixel ratio, so high-density
+ * screens can go below one scene pixel per device pixel without the image
+ * dropping under half the logical resolution.
+ */
+class ResolutionController {
+ public:
+  void initialize(QOpenGLFunctions_3_3_Core *functions);
+  void destroy();
+
+  void setTarget(float milliseconds) { targetTime = milliseconds; }
+  void setDevicePixelRatio(float ratio);
+  void setEnabled(bool enabled);
+
+  void beginFrame();
+  void endFrame();
+
+  float getScale() const { return enabled ? scale : 1.0f; }
+  float getGpuTime() const { return gpuTime; }
+  float getCpuTime() const { return cpuTime; }
+
+ private:
+  static constexpr int queryCount = 4;
+  static constexpr float step = 0.05f;
+
+  void adjust();
+
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+  GLuint queries[queryCount] = {};
+  bool pending[queryCount] = {};
+  int current = 0;
+  QElapsedTimer frameTimer;
+
+  bool enabled = true;
+  float targetTime = 1000.0f / 60.0f;  // milliseconds
+  float gpuTime = 0.0f;                // milliseconds, smoothed
+  float cpuTime = 0.0f;                // milliseconds, smoothed
+  float scale = 1.0f;
+  float minScale = 0.5f;
+  float devicePixelRatio = 1.0f;
+};
+
+#endif  // RESOLUTIONCONTROLLER_H
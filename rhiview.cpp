@@ -0,0 +1,255 @@
+#include "rhiview.h"
+
+#include <QFile>
+#include <QQuaternion>
+#include <QShader>
+#include <cstddef>
+#include <cstring>
+
+#include "model.h"
+#include "scenegeometry.h"
+
+namespace {
+
+// Weight of the newest measurement in the smoothed times
+const float smoothing = 0.1f;
+
+// Model and projection transformation of one node, as in the uniform block
+struct Transforms {
+  float model[16];
+  float projection[16];
+};
+
+QShader loadShader(const QString &name) {
+  QFile file(name);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qDebug() << ":: Could not open" << name;
+    return QShader();
+  }
+  return QShader::fromSerialized(file.readAll());
+}
+
+}  // namespace
+
+/**
+ * @brief RhiView::RhiView Constructs the view and its scene graph, with the
+ * backend selected by the RHI_BACKEND environment variable.
+ * @param parent Parent widget.
+ */
+RhiView::RhiView(QWidget *parent) : QRhiWidget(parent) {
+  // The backing store of a widget window creates its QRhi with
+  // QRhi::EnableTimestamps when asked through the variable Qt Quick uses.
+  // The view gets a window of its own, whose QRhi is created when first shown
+  if (!qEnvironmentVariableIsSet("QSG_RHI_PROFILE")) {
+    qputenv("QSG_RHI_PROFILE", "1");
+  }
+
+  QString backend = qEnvironmentVariable("RHI_BACKEND", "vulkan").toLower();
+#if QT_CONFIG(vulkan)
+  setApi(backend == "opengl" ? Api::OpenGL : Api::Vulkan);
+#else
+  setApi(Api::OpenGL);
+#endif
+
+  Model knot(":/models/knot.obj");
+  geometry = {pyramidVertices(), coloredVertices(knot.getMeshCoords()),
+              floorVertices()};
+
+  // The same scene graph as the main view, with the same mesh indices
+  QVector<AABB> bounds;
+  for (const QVector<Vertex> &vertices : geometry) {
+    AABB box;
+    for (const Vertex &v : vertices) box.expand(QVector3D(v.x, v.y, v.z));
+    bounds.append(box);
+  }
+  pyramidNode = scene.addChild("pyramid");
+  pyramidNode->setMesh(0, bounds[0]);
+  pyramidNode->setTranslation(QVector3D(-2, 0, -6));
+  knotNode = scene.addChild("knot");
+  knotNode->setMesh(1, bounds[1]);
+  knotNode->setTranslation(QVector3D(2, 0, -6));
+  floorNode = scene.addChild("floor");
+  floorNode->setMesh(2, bounds[2]);
+  floorNode->setTranslation(QVector3D(0, -2.6f, -8));
+  floorNode->setScale(QVector3D(10, 1, 10));
+}
+
+/**
+ * @brief RhiView::getBackendName Returns the name of the graphics API in use.
+ * @return Name of the QRhi backend, or the requested API before the first
+ * frame.
+ */
+QString RhiView::getBackendName() const {
+  if (currentRhi) return QString::fromLatin1(currentRhi->backendName());
+  return api() == Api::Vulkan ? "Vulkan" : "OpenGL";
+}
+
+/**
+ * @brief RhiView::initialize Called before the first frame and whenever the
+ * QRhi or the render target changed; creates the resources for a new QRhi and
+ * adapts the projection to the render target size.
+ * @param cb Unused.
+ */
+void RhiView::initialize(QRhiCommandBuffer *cb) {
+  Q_UNUSED(cb)
+  if (currentRhi != rhi()) {
+    pipeline.reset();
+    currentRhi = rhi();
+    qDebug() << ":: Rendering through QRhi with" << currentRhi->backendName();
+  }
+  if (!pipeline) createResources();
+
+  // Clip space differs between the APIs; the correction maps the OpenGL
+  // convention of the projection onto the one of the backend
+  QSize size = renderTarget()->pixelSize();
+  projection = currentRhi->clipSpaceCorrMatrix();
+  projection.perspective(60.0f, size.width() / float(size.height()), 0.2f,
+                         20.0f);
+}
+
+/**
+ * @brief RhiView::releaseResources Called before the QRhi goes away; drops
+ * every resource created from it.
+ */
+void RhiView::releaseResources() {
+  pipeline.reset();
+  bindings.reset();
+  transforms.reset();
+  vertexBuffers.clear();
+  initialUpdates = nullptr;
+  currentRhi = nullptr;
+}
+
+/**
+ * @brief RhiView::createResources Uploads the meshes and builds the pipeline.
+ */
+void RhiView::createResources() {
+  initialUpdates = currentRhi->nextResourceUpdateBatch();
+
+  vertexBuffers.clear();
+  for (const QVector<Vertex> &vertices : geometry) {
+    quint32 bytes = vertices.size() * sizeof(Vertex);
+    std::unique_ptr<QRhiBuffer> buffer(currentRhi->newBuffer(
+        QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, bytes));
+    buffer->create();
+    initialUpdates->uploadStaticBuffer(buffer.get(), vertices.constData());
+    vertexBuffers.push_back(std::move(buffer));
+  }
+
+  // One block per mesh, at the offset alignment of the backend
+  transformStride = currentRhi->ubufAligned(sizeof(Transforms));
+  transforms.reset(currentRhi->newBuffer(QRhiBuffer::Dynamic,
+                                         QRhiBuffer::UniformBuffer,
+                                         transformStride * geometry.size()));
+  transforms->create();
+
+  bindings.reset(currentRhi->newShaderResourceBindings());
+  bindings->setBindings({QRhiShaderResourceBinding::uniformBufferWithDynamicOffset(
+      0, QRhiShaderResourceBinding::VertexStage, transforms.get(),
+      sizeof(Transforms))});
+  bindings->create();
+
+  pipeline.reset(currentRhi->newGraphicsPipeline());
+  pipeline->setShaderStages(
+      {{QRhiShaderStage::Vertex, loadShader(":/shaders/rhivertshader.vert.qsb")},
+       {QRhiShaderStage::Fragment,
+        loadShader(":/shaders/rhifragshader.frag.qsb")}});
+  QRhiVertexInputLayout layout;
+  layout.setBindings({{sizeof(Vertex)}});
+  layout.setAttributes(
+      {{0, 0, QRhiVertexInputAttribute::Float3, offsetof(Vertex, x)},
+       {0, 1, QRhiVertexInputAttribute::Float3, offsetof(Vertex, r)}});
+  pipeline->setVertexInputLayout(layout);
+  pipeline->setDepthTest(true);
+  pipeline->setDepthWrite(true);
+  pipeline->setDepthOp(QRhiGraphicsPipeline::LessOrEqual);
+  pipeline->setCullMode(QRhiGraphicsPipeline::Back);
+  pipeline->setSampleCount(sampleCount());
+  pipeline->setShaderResourceBindings(bindings.get());
+  pipeline->setRenderPassDescriptor(renderTarget()->renderPassDescriptor());
+  pipeline->create();
+}
+
+/**
+ * @brief RhiView::render Records the commands of a frame, and takes over the
+ * GPU time of the last frame the GPU completed.
+ * @param cb Command buffer of the frame.
+ */
+void RhiView::render(QRhiCommandBuffer *cb) {
+  frameTimer.start();
+
+  // Seconds, 0 until timestamps of a frame are available
+  double lastGpuTime = cb->lastCompletedGpuTime();
+  if (lastGpuTime > 0.0) {
+    gpuTime += smoothing * (float(lastGpuTime) * 1.0e3f - gpuTime);
+  }
+
+  QRhiResourceUpdateBatch *updates = initialUpdates;
+  initialUpdates = nullptr;
+  if (!updates) updates = currentRhi->nextResourceUpdateBatch();
+
+  QVector<SceneNode *> drawables;
+  scene.collectDrawables(drawables);
+  for (SceneNode *node : drawables) {
+    Transforms block;
+    memcpy(block.model, node->worldTransform().constData(), sizeof(block.model));
+    memcpy(block.projection, projection.constData(), sizeof(block.projection));
+    updates->updateDynamicBuffer(transforms.get(),
+                                 node->getMesh() * transformStride,
+                                 sizeof(Transforms), &block);
+  }
+
+  QSize size = renderTarget()->pixelSize();
+  cb->beginPass(renderTarget(), QColor::fromRgbF(0.37f, 0.42f, 0.45f, 1.0f),
+                {1.0f, 0}, updates);
+  cb->setGraphicsPipeline(pipeline.get());
+  cb->setViewport({0, 0, float(size.width()), float(size.height())});
+  for (SceneNode *node : drawables) {
+    int mesh = node->getMesh();
+    QRhiCommandBuffer::DynamicOffset offset(0, mesh * transformStride);
+    cb->setShaderResources(bindings.get(), 1, &offset);
+    QRhiCommandBuffer::VertexInput input(vertexBuffers[mesh].get(), 0);
+    cb->setVertexInput(0, 1, &input);
+    cb->draw(geometry[mesh].size());
+  }
+  cb->endPass();
+
+  cpuTime += smoothing * (frameTimer.nsecsElapsed() / 1.0e6f - cpuTime);
+}
+
+/**
+ * @brief RhiView::rotateAndScale Applies the rotation and scale to the
+ * pyramid and the knot, as in the main view.
+ */
+void RhiView::rotateAndScale() {
+  QQuaternion rotation = QQuaternion::fromAxisAndAngle(1.0, 0.0, 0.0, rotX) *
+                         QQuaternion::fromAxisAndAngle(0.0, 1.0, 0.0, rotY) *
+                         QQuaternion::fromAxisAndAngle(0.0, 0.0, 1.0, rotZ);
+  for (SceneNode *node : {pyramidNode, knotNode}) {
+    node->setRotation(rotation);
+    node->setScale(scaling);
+  }
+  update();
+}
+
+/**
+ * @brief RhiView::setRotation Changes the rotation of the displayed objects.
+ * @param rotateX Number of degrees to rotate around the x axis.
+ * @param rotateY Number of degrees to rotate around the y axis.
+ * @param rotateZ Number of degrees to rotate around the z axis.
+ */
+void RhiView::setRotation(int rotateX, int rotateY, int rotateZ) {
+  rotX = rotateX;
+  rotY = rotateY;
+  rotZ = rotateZ;
+  rotateAndScale();
+}
+
+/**
+ * @brief RhiView::setScale Changes the scale of the displayed objects.
+ * @param scale The new scale factor.
+ */
+void RhiView::setScale(float scale) {
+  scaling = scale;
+  rotateAndScale();
+}
@@ -0,0 +1,82 @@
+#ifndef RHIVIEW_H
+#define RHIVIEW_H
+
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QRhiWidget>
+#include <QVector>
+#include <memory>
+#include <vector>
+#include <rhi/qrhi.h>
+
+#include "scenenode.h"
+#include "vertex.h"
+
+/**
+ * @brief Renders the scene of the main view through QRhi instead of OpenGL.
+ *
+ * The pyramid, the knot and the floor are drawn with the plain vertex color
+ * shading of the main view, from one graphics pipeline built up front and a
+ * uniform buffer holding the transformations of all nodes, addressed with
+ * dynamic offsets. The backend is chosen with the RHI_BACKEND environment
+ * variable ("vulkan", the default where Qt supports it, or "opengl"); Vulkan
+ * runs on machines without a GPU through lavapipe.
+ *
+ * Widgets composed through different graphics APIs cannot share a window, so
+ * the view is shown as a window of its own next to the main window. Its QRhi
+ * is created by that window with timestamps enabled, so the GPU time of the
+ * frames is measured as well.
+ *
+ * The view is only built where Qt ShaderTools 6.7 is found, which defines
+ * HAVE_RHI_VIEW.
+ */
+class RhiView : public QRhiWidget {
+  Q_OBJECT
+
+ public:
+  explicit RhiView(QWidget *parent = nullptr);
+
+  void setRotation(int rotateX, int rotateY, int rotateZ);
+  void setScale(float scale);
+
+  QString getBackendName() const;
+  // Smoothed CPU time of recording a frame, and GPU time of executing one
+  float getCpuTime() const { return cpuTime; }
+  float getGpuTime() const { return gpuTime; }
+
+ protected:
+  void initialize(QRhiCommandBuffer *cb) override;
+  void render(QRhiCommandBuffer *cb) override;
+  void releaseResources() override;
+
+ private:
+  void createResources();
+  void rotateAndScale();
+
+  // Vertices of the pyramid, the knot and the floor, by mesh index
+  QVector<QVector<Vertex>> geometry;
+
+  QRhi *currentRhi = nullptr;
+  QRhiResourceUpdateBatch *initialUpdates = nullptr;
+  std::vector<std::unique_ptr<QRhiBuffer>> vertexBuffers;
+  std::unique_ptr<QRhiBuffer> transforms;
+  quint32 transformStride = 0;
+  std::unique_ptr<QRhiShaderResourceBindings> bindings;
+  std::unique_ptr<QRhiGraphicsPipeline> pipeline;
+  QMatrix4x4 projection;
+
+  SceneNode scene{"root"};
+  SceneNode *pyramidNode;
+  SceneNode *knotNode;
+  SceneNode *floorNode;
+  int rotX = 0;
+  int rotY = 0;
+  int rotZ = 0;
+  float scaling = 1;
+
+  QElapsedTimer frameTimer;
+  float cpuTime = 0.0f;  // milliseconds, smoothed
+  float gpuTime = 0.0f;  // milliseconds, smoothed
+};
+
+#endif  // RHIVIEW_H
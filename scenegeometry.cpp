@@ -0,0 +1,51 @@
+#include "scenegeometry.h"
+
+#include <cmath>
+
+/**
+ * @brief pyramidVertices Returns the triangles of the pyramid, with a color
+ * per corner.
+ * @return 18 vertices.
+ */
+QVector<Vertex> pyramidVertices() {
+  // Pyramid vertices
+  Vertex a {-1,1,1,1,0,0};
+  Vertex b {1,1,1,0,1,0};
+  Vertex c {0,0,-1,1,0,1};
+  Vertex d {1,-1,1,1,1,0};
+  Vertex e {-1,-1,1,0,0,1};
+
+  // Array of pyramid vertices arranged painstakingly :(
+  return {a,e,d,b,a,d,d,c,b,b,c,a,a,c,e,e,c,d};
+}
+
+/**
+ * @brief floorVertices Returns the floor receiving the shadows, two grey
+ * triangles facing up.
+ * @return 6 vertices.
+ */
+QVector<Vertex> floorVertices() {
+  Vertex floorA {-1,0,-1,0.6,0.6,0.6};
+  Vertex floorB {-1,0,1,0.6,0.6,0.6};
+  Vertex floorC {1,0,1,0.6,0.6,0.6};
+  Vertex floorD {1,0,-1,0.6,0.6,0.6};
+  return {floorA,floorB,floorC,floorA,floorC,floorD};
+}
+
+/**
+ * @brief coloredVertices Converts the coordinates of a model to vertices.
+ * @param coords Coordinates for glDrawArrays, as given by Model::getMeshCoords.
+ * @return A vertex per coordinate.
+ */
+QVector<Vertex> coloredVertices(const QVector<QVector3D> &coords) {
+  QVector<Vertex> vertices(coords.size());
+  for (int i = 0; i < coords.size(); i++) {
+      vertices[i].x = coords[i].x();
+      vertices[i].y = coords[i].y();
+      vertices[i].z = coords[i].z();
+      vertices[i].r = std::fabs(coords[i].x());
+      vertices[i].g = std::fabs(coords[i].y());
+      vertices[i].b = std::fabs(coords[i].z());
+  }
+  return vertices;
+}
@@ -0,0 +1,16 @@
+#ifndef SCENEGEOMETRY_H
+#define SCENEGEOMETRY_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "vertex.h"
+
+// Vertices of the meshes in the scene, the same for every rendering backend
+QVector<Vertex> pyramidVertices();
+QVector<Vertex> floorVertices();
+
+// Vertices of a loaded model, colored by the absolute value of the position
+QVector<Vertex> coloredVertices(const QVector<QVector3D> &coords);
+
+#endif  // SCENEGEOMETRY_H
@@ -0,0 +1,170 @@
+#include "scenenode.h"
+
+/**
+ * @brief SceneNode::SceneNode Constructs a new node with an identity
+ * transformation.
+ * @param name Name of the node, used for debugging.
+ */
+SceneNode::SceneNode(const QString &name) : name(name) {}
+
+/**
+ * @brief SceneNode::~SceneNode Destroys the node and its whole subtree.
+ */
+SceneNode::~SceneNode() { qDeleteAll(children); }
+
+/**
+ * @brief SceneNode::addChild Creates a new child node, owned by this node.
+ * @param name Name of the child.
+ * @return The new child.
+ */
+SceneNode *SceneNode::addChild(const QString &name) {
+  SceneNode *child = new SceneNode(name);
+  child->parent = this;
+  children.append(child);
+  invalidateSubtreeBounds();
+  return child;
+}
+
+/**
+ * @brief SceneNode::setTranslation Sets the translation relative to the parent.
+ * @param translation The new translation.
+ */
+void SceneNode::setTranslation(const QVector3D &translation) {
+  if (this->translation == translation) return;
+  this->translation = translation;
+  invalidateLocal();
+}
+
+/**
+ * @brief SceneNode::setRotation Sets the rotation relative to the parent.
+ * @param rotation The new rotation.
+ */
+void SceneNode::setRotation(const QQuaternion &rotation) {
+  if (this->rotation == rotation) return;
+  this->rotation = rotation;
+  invalidateLocal();
+}
+
+/**
+ * @brief SceneNode::setScale Sets the scale relative to the parent.
+ * @param scale The new scale for each axis.
+ */
+void SceneNode::setScale(const QVector3D &scale) {
+  if (this->scale == scale) return;
+  this->scale = scale;
+  invalidateLocal();
+}
+
+/**
+ * @brief SceneNode::localTransform Returns translation * rotation * scale,
+ * recomputing it only if one of them changed.
+ * @return The local transformation.
+ */
+const QMatrix4x4 &SceneNode::localTransform() {
+  if (localDirty) {
+    local.setToIdentity();
+    local.translate(translation);
+    local.rotate(rotation);
+    local.scale(scale);
+    localDirty = false;
+  }
+  return local;
+}
+
+/**
+ * @brief SceneNode::worldTransform Returns the transformation from this node to
+ * world space. Only the dirty part of the path to the root is recomputed.
+ * @return The world transformation.
+ */
+const QMatrix4x4 &SceneNode::worldTransform() {
+  if (worldDirty) {
+    world = parent ? parent->worldTransform() * localTransform()
+                   : localTransform();
+    worldDirty = false;
+  }
+  return world;
+}
+
+/**
+ * @brief SceneNode::setMesh Attaches geometry to this node.
+ * @param meshIndex Index of the mesh in the renderer, -1 for none.
+ * @param meshBounds Object-space bounds of the mesh.
+ */
+void SceneNode::setMesh(int meshIndex, const AABB &meshBounds) {
+  mesh = meshIndex;
+  localBounds = meshBounds;
+  boundsDirty = true;
+  version++;
+  invalidateSubtreeBounds();
+}
+
+/**
+ * @brief SceneNode::worldBounds Returns the world-space bounds of this node's
+ * own geometry, recomputed lazily after it moved.
+ * @return The world-space bounds, empty if the node has no mesh.
+ */
+const AABB &SceneNode::worldBounds() {
+  if (boundsDirty) {
+    bounds = localBounds.transformed(worldTransform());
+    boundsDirty = false;
+  }
+  return bounds;
+}
+
+/**
+ * @brief SceneNode::subtreeBounds Returns the world-space bounds of this node
+ * and all of its descendants. Clean children are not revisited.
+ * @return The world-space bounds of the subtree.
+ */
+const AABB &SceneNode::subtreeBounds() {
+  if (subtreeDirty) {
+    subtree = worldBounds();
+    for (SceneNode *child : children) subtree.expand(child->subtreeBounds());
+    subtreeDirty = false;
+  }
+  return subtree;
+}
+
+/**
+ * @brief SceneNode::collectDrawables Gathers all nodes in this subtree that
+ * have a mesh attached.
+ * @param out List the nodes are appended to.
+ */
+void SceneNode::collectDrawables(QVector<SceneNode *> &out) {
+  if (mesh >= 0) out.append(this);
+  for (SceneNode *child : children) child->collectDrawables(out);
+}
+
+/**
+ * @brief SceneNode::invalidateLocal Marks the local transformation dirty, and
+ * with it the world transformations of the subtree.
+ */
+void SceneNode::invalidateLocal() {
+  localDirty = true;
+  invalidateWorld();
+  if (parent) parent->invalidateSubtreeBounds();
+}
+
+/**
+ * @brief SceneNode::invalidateWorld Marks the world transformation and bounds
+ * of this subtree dirty. A dirty node always has dirty descendants, so the
+ * recursion stops as soon as it reaches one.
+ */
+void SceneNode::invalidateWorld() {
+  if (worldDirty) return;
+  worldDirty = true;
+  version++;
+  boundsDirty = true;
+  subtreeDirty = true;
+  for (SceneNode *child : children) child->invalidateWorld();
+}
+
+/**
+ * @brief SceneNode::invalidateSubtreeBounds Marks the subtree bounds of this
+ * node and its ancestors dirty, stopping at the first one that already is.
+ */
+void SceneNode::invalidateSubtreeBounds() {
+  for (SceneNode *node = this; node && !node->subtreeDirty; node = node->parent) {
+    node->subtreeDirty = true;
+  }
+}
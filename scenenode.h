@@ -0,0 +1,96 @@
+#ifndef SCENENODE_H
+#define SCENENODE_H
+
+#include <QMatrix4x4>
+#include <QQuaternion>
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+
+#include "bounds.h"
+
+/**
+ * @brief A node in the hierarchical scene graph. Every node carries a local
+ * translation, rotation and scale, and caches its world transformation and
+ * world-space bounds.
+ *
+ * Changing a node only marks its own subtree dirty (and the subtree bounds of
+ * its ancestors), so the cost of moving a node is proportional to the size of
+ * its subtree. World transforms and bounds are recomputed lazily on access.
+ */
+class SceneNode {
+ public:
+  explicit SceneNode(const QString &name = QString());
+  ~SceneNode();
+
+  SceneNode(const SceneNode &) = delete;
+  SceneNode &operator=(const SceneNode &) = delete;
+
+  // Hierarchy, children are owned by their parent
+  SceneNode *addChild(const QString &name = QString());
+  SceneNode *getParent() const { return parent; }
+  const QVector<SceneNode *> &getChildren() const { return children; }
+  const QString &getName() const { return name; }
+
+  // Local TRS
+  void setTranslation(const QVector3D &translation);
+  void setRotation(const QQuaternion &rotation);
+  void setScale(const QVector3D &scale);
+  void setScale(float scale) { setScale(QVector3D(scale, scale, scale)); }
+  const QVector3D &getTranslation() const { return translation; }
+  const QQuaternion &getRotation() const { return rotation; }
+  const QVector3D &getScale() const { return scale; }
+
+  // Cached transformations
+  const QMatrix4x4 &localTransform();
+  const QMatrix4x4 &worldTransform();
+
+  // Increases whenever the world transformation or bounds may have changed
+  quint64 getVersion() const { return version; }
+
+  // Geometry of this node, -1 if it does not draw anything
+  void setMesh(int meshIndex, const AABB &meshBounds);
+  int getMesh() const { return mesh; }
+
+  // Level of detail the mesh was last drawn with
+  void setLod(int level) { lod = level; }
+  int getLod() const { return lod; }
+
+  // Cached world-space bounds of this node's geometry and of its subtree
+  const AABB &worldBounds();
+  const AABB &subtreeBounds();
+
+  // Appends every node of this subtree that has a mesh
+  void collectDrawables(QVector<SceneNode *> &out);
+
+ private:
+  void invalidateLocal();
+  void invalidateWorld();
+  void invalidateSubtreeBounds();
+
+  QString name;
+  SceneNode *parent = nullptr;
+  QVector<SceneNode *> children;
+
+  QVector3D translation{0, 0, 0};
+  QQuaternion rotation;
+  QVector3D scale{1, 1, 1};
+
+  quint64 version = 0;
+
+  int mesh = -1;
+  int lod = 0;
+  AABB localBounds;
+
+  QMatrix4x4 local;
+  QMatrix4x4 world;
+  AABB bounds;
+  AABB subtree;
+
+  bool localDirty = true;
+  bool worldDirty = true;
+  bool boundsDirty = true;
+  bool subtreeDirty = true;
+};
+
+#endif  // SCENENODE_H
@@ -0,0 +1,31 @@
+#version 330 core
+
+// Emits the instance only if it passed the frustum test; transform feedback
+// captures the emitted points into the buffer of visible instances
+
+layout(points) in;
+layout(points, max_vertices = 1) out;
+
+// Specify the inputs to the geometry shader
+in vec4 instanceColumn0_vs[];
+in vec4 instanceColumn1_vs[];
+in vec4 instanceColumn2_vs[];
+in vec4 instanceColumn3_vs[];
+flat in int visible_vs[];
+
+// Specify the output of the geometry stage, captured by transform feedback
+out vec4 instanceColumn0;
+out vec4 instanceColumn1;
+out vec4 instanceColumn2;
+out vec4 instanceColumn3;
+
+void main() {
+  if (visible_vs[0] == 0) return;
+
+  instanceColumn0 = instanceColumn0_vs[0];
+  instanceColumn1 = instanceColumn1_vs[0];
+  instanceColumn2 = instanceColumn2_vs[0];
+  instanceColumn3 = instanceColumn3_vs[0];
+  EmitVertex();
+  EndPrimitive();
+}
@@ -0,0 +1,50 @@
+#version 330 core
+
+// Frustum test of one instance, run as a point per instance
+
+// Specify the input locations of attributes
+// Columns of the model transformation of the instance
+layout(location = 0) in vec4 instanceColumn0_in;
+layout(location = 1) in vec4 instanceColumn1_in;
+layout(location = 2) in vec4 instanceColumn2_in;
+layout(location = 3) in vec4 instanceColumn3_in;
+
+// Specify the Uniforms of the vertex shader
+// Object-space bounds of the mesh and the normalized frustum planes
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+uniform vec4 frustumPlanes[6];
+
+// Range of distances from the eye, for splitting off impostors
+uniform mat4 viewTransform;
+uniform float minDistance;
+uniform float maxDistance;
+
+// Specify the output of the vertex stage
+out vec4 instanceColumn0_vs;
+out vec4 instanceColumn1_vs;
+out vec4 instanceColumn2_vs;
+out vec4 instanceColumn3_vs;
+flat out int visible_vs;
+
+void main() {
+  mat4 model = mat4(instanceColumn0_in, instanceColumn1_in, instanceColumn2_in,
+                    instanceColumn3_in);
+
+  // World-space bounds enclosing the transformed box
+  vec3 center = (model * vec4(boundsCenter, 1.0F)).xyz;
+  mat3 absModel = mat3(abs(model[0].xyz), abs(model[1].xyz), abs(model[2].xyz));
+  vec3 extent = absModel * boundsExtent;
+
+  float eyeDistance = length((viewTransform * vec4(center, 1.0F)).xyz);
+  visible_vs = int(eyeDistance >= minDistance && eyeDistance < maxDistance);
+  for (int i = 0; i < 6; i++) {
+    float distance = dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w;
+    if (distance < -dot(abs(frustumPlanes[i].xyz), extent)) visible_vs = 0;
+  }
+
+  instanceColumn0_vs = instanceColumn0_in;
+  instanceColumn1_vs = instanceColumn1_in;
+  instanceColumn2_vs = instanceColumn2_in;
+  instanceColumn3_vs = instanceColumn3_in;
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+// Specify the inputs to the fragment shader
+in vec2 texCoords;
+
+// Depth buffer of the software occluder, in window coordinates
+uniform sampler2D depthTexture;
+
+// Near and far plane of the projection of the view, and whether it is
+// orthographic, in which case the depth is linear already
+uniform float nearPlane;
+uniform float farPlane;
+uniform bool orthographic;
+
+// Specify the output of the fragment shader
+out vec4 fColor;
+
+void main() {
+  // Linearizing the depth, so that nearby occluders stand out
+  float depth = texture(depthTexture, texCoords).r;
+  if (!orthographic) {
+    float ndc = depth * 2.0F - 1.0F;
+    float linear = 2.0F * nearPlane * farPlane /
+                   (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+    depth = (linear - nearPlane) / (farPlane - nearPlane);
+  }
+  fColor = vec4(vec3(depth), 1.0F);
+}
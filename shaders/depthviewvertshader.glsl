@@ -0,0 +1,12 @@
+#version 330 core
+
+// Quad covering the viewport, generated from the vertex index
+// Drawn as a triangle strip of 4 vertices without any attributes
+
+// Specify the output of the vertex stage
+out vec2 texCoords;
+
+void main() {
+  texCoords = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+  gl_Position = vec4(texCoords * 2.0F - 1.0F, 0.0F, 1.0F);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+// Specify the inputs to the fragment shader
+in vec2 texCoords;
+in vec3 viewPosition;
+flat in vec3 toEye;
+flat in float radius;
+
+// Specify the Uniforms of the fragment shaders
+uniform mat4 projectionTransform;
+uniform sampler2D colorAtlas;
+uniform sampler2D depthAtlas;
+
+// Specify the output of the fragment shader
+out vec4 fColor;
+
+void main() {
+  vec4 color = texture(colorAtlas, texCoords);
+  if (color.a < 0.5F) discard;
+
+  // The baked depth spans the bounding sphere, from its front to its back
+  float depth = texture(depthAtlas, texCoords).r;
+  vec3 position = viewPosition + toEye * radius * (1.0F - 2.0F * depth);
+  vec4 clip = projectionTransform * vec4(position, 1.0F);
+  gl_FragDepth = clip.z / clip.w * 0.5F + 0.5F;
+
+  fColor = vec4(color.rgb, 1.0F);
+}
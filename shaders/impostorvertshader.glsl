@@ -0,0 +1,60 @@
+#version 330 core
+
+// Define constants
+#define M_PI 3.141593
+#define AZIMUTHS 8
+#define ELEVATIONS 3
+#define ELEVATION_STEP (M_PI / 4.0F)
+
+// Quad facing the eye, generated from the vertex index
+// Drawn as a triangle strip of 4 vertices per instance
+
+// Specify the input locations of attributes
+// Columns of the model transformation of the instance
+layout(location = 0) in vec4 instanceColumn0_in;
+layout(location = 1) in vec4 instanceColumn1_in;
+layout(location = 2) in vec4 instanceColumn2_in;
+layout(location = 3) in vec4 instanceColumn3_in;
+
+// Specify the Uniforms of the vertex shader
+uniform mat4 viewTransform;
+uniform mat4 projectionTransform;
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+
+// Specify the output of the vertex stage
+out vec2 texCoords;
+out vec3 viewPosition;
+flat out vec3 toEye;
+flat out float radius;
+
+void main() {
+  // Working in view space, so the eye is at the origin
+  mat4 model = viewTransform * mat4(instanceColumn0_in, instanceColumn1_in,
+                                    instanceColumn2_in, instanceColumn3_in);
+
+  vec3 center = (model * vec4(boundsCenter, 1.0F)).xyz;
+  radius = boundsRadius * max(length(model[0].xyz),
+                              max(length(model[1].xyz), length(model[2].xyz)));
+
+  // An orthographic projection looks along -z everywhere; the quad keeps the
+  // up axis of the object, like the baked views
+  bool orthographic = projectionTransform[3][3] == 1.0F;
+  toEye = orthographic ? vec3(0.0F, 0.0F, 1.0F) : normalize(-center);
+  vec3 right = normalize(cross(normalize(model[1].xyz), toEye));
+  vec3 up = cross(toEye, right);
+
+  // Picking the baked view closest to the direction of the eye
+  vec3 direction = normalize(inverse(mat3(model)) * toEye);
+  int azimuth = int(round(atan(direction.x, direction.z) * AZIMUTHS / (2.0F * M_PI)));
+  azimuth = (azimuth % AZIMUTHS + AZIMUTHS) % AZIMUTHS;
+  int elevation = int(round(asin(clamp(direction.y, -1.0F, 1.0F)) / ELEVATION_STEP));
+  elevation = clamp(elevation + ELEVATIONS / 2, 0, ELEVATIONS - 1);
+
+  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+  texCoords = (vec2(azimuth, elevation) + corner) / vec2(AZIMUTHS, ELEVATIONS);
+
+  viewPosition = center + (right * (corner.x * 2.0F - 1.0F) +
+                           up * (corner.y * 2.0F - 1.0F)) * radius;
+  gl_Position = projectionTransform * vec4(viewPosition, 1.0F);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+// The attributes vertCoordinates_in and vertColor_in are declared by the
+// vertex format of the meshes, see vertex.h. Position-only meshes store no
+// colors; they follow from the positions instead
+#pragma feature POSITION_ONLY
+
+// Model transformation of the instance, occupies locations 2 to 5
+layout(location = 2) in mat4 modelTransform_in;
+
+// Specify the Uniforms of the vertex shader
+uniform mat4 viewTransform;
+uniform mat4 projectionTransform;
+
+// Specify the output of the vertex stage
+out vec3 vertColor;
+
+void main() {
+  gl_Position = projectionTransform * viewTransform * modelTransform_in *
+                vec4(vertCoordinates_in, 1.0F);
+#ifdef POSITION_ONLY
+  vertColor = abs(vertCoordinates_in);
+#else
+  vertColor = vertColor_in;
+#endif
+}
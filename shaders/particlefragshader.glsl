@@ -0,0 +1,17 @@
+#version 330 core
+
+// Specify the inputs to the fragment shader
+in float vertLife;
+
+// Specify the output of the fragment shader
+out vec4 fColor;
+
+void main() {
+  // Round sprites, fading towards the edge and with age
+  float radius = length(gl_PointCoord - vec2(0.5F)) * 2.0F;
+  if (radius > 1.0F) {
+    discard;
+  }
+  vec3 color = mix(vec3(0.3F, 0.5F, 1.0F), vec3(0.8F, 0.95F, 1.0F), vertLife);
+  fColor = vec4(color, (1.0F - radius) * vertLife * 0.5F);
+}
@@ -0,0 +1,78 @@
+#version 330 core
+
+// Particle simulation: one vertex per particle, the outputs are captured with
+// transform feedback and nothing is rasterized
+
+// Specify the inputs to the vertex shader
+layout(location = 0) in vec4 position;  // age in w
+layout(location = 1) in vec4 velocity;  // lifetime in w
+
+// Specify the Uniforms of the vertex shader
+uniform float deltaTime;
+uniform float time;
+uniform vec3 emitterPosition;
+uniform vec3 emitterDirection;
+uniform float spread;
+uniform float speed;
+uniform float lifetime;
+uniform vec3 gravity;
+uniform vec3 wind;
+uniform float drag;
+uniform float floorHeight;
+
+// Specify the outputs of the vertex shader, captured in the next buffer
+out vec4 outPosition;
+out vec4 outVelocity;
+
+uint hash(uint x) {
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+// Uniform random number in [0, 1]
+float random(uint seed) {
+  return float(hash(seed)) / 4294967295.0F;
+}
+
+void main() {
+  float age = position.w + deltaTime;
+  if (age < velocity.w) {
+    // Alive: drag pulls the velocity towards the wind
+    vec3 v = velocity.xyz + (gravity + drag * (wind - velocity.xyz)) * deltaTime;
+    vec3 p = position.xyz + v * deltaTime;
+    if (p.y < floorHeight && v.y < 0.0F) {
+      p.y = floorHeight;
+      v.y *= -0.4F;
+      v.xz *= 0.8F;
+    }
+    outPosition = vec4(p, age);
+    outVelocity = vec4(v, velocity.w);
+    return;
+  }
+
+  // Dead: a particle is born again with a chance per second of one over the
+  // lifetime, which keeps the population steady
+  uint seed = hash(uint(gl_VertexID) ^ floatBitsToUint(time)) * 5U;
+  if (random(seed) >= deltaTime / lifetime) {
+    outPosition = vec4(position.xyz, velocity.w);
+    outVelocity = velocity;
+    return;
+  }
+
+  vec3 side = normalize(cross(emitterDirection, abs(emitterDirection.y) < 0.99F
+                                                    ? vec3(0.0F, 1.0F, 0.0F)
+                                                    : vec3(1.0F, 0.0F, 0.0F)));
+  vec3 up = cross(emitterDirection, side);
+  float angle = 6.283185F * random(seed + 1U);
+  float cone = spread * sqrt(random(seed + 2U));
+  vec3 direction = cos(cone) * emitterDirection +
+                   sin(cone) * (cos(angle) * side + sin(angle) * up);
+
+  outPosition = vec4(emitterPosition, 0.0F);
+  outVelocity = vec4(direction * speed * (0.8F + 0.4F * random(seed + 3U)),
+                     lifetime * (0.5F + random(seed + 4U)));
+}
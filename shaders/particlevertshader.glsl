@@ -0,0 +1,26 @@
+#version 330 core
+
+// Specify the inputs to the vertex shader
+layout(location = 0) in vec4 position;  // age in w
+layout(location = 1) in vec4 velocity;  // lifetime in w
+
+// Specify the Uniforms of the vertex shader
+uniform mat4 viewTransform;
+uniform mat4 projectionTransform;
+uniform float pointScale;
+
+// Specify the output of the vertex stage
+out float vertLife;  // remaining fraction of the lifetime
+
+void main() {
+  gl_PointSize = 1.0F;
+  if (position.w >= velocity.w) {
+    // Dead particles are clipped
+    gl_Position = vec4(2.0F, 2.0F, 2.0F, 1.0F);
+    vertLife = 0.0F;
+    return;
+  }
+  gl_Position = projectionTransform * viewTransform * vec4(position.xyz, 1.0F);
+  gl_PointSize = max(pointScale / gl_Position.w, 1.0F);
+  vertLife = 1.0F - position.w / velocity.w;
+}
@@ -0,0 +1,41 @@
+// Applies the reduced-resolution ambient occlusion, upsampled with weights
+// that fall off with the depth difference to the full-resolution pixel
+
+uniform sampler2D depthTexture;
+uniform sampler2D occlusionTexture;
+uniform float nearPlane;
+uniform float farPlane;
+uniform bool orthographic;
+uniform float occlusionStrength;
+
+vec3 ambientOcclusion(vec3 color) {
+  // Linear depth as in postocclusionfragshader.glsl
+  float depth = texture(depthTexture, texCoords).r;
+  if (orthographic) {
+    depth = mix(nearPlane, farPlane, depth);
+  } else {
+    float ndc = depth * 2.0F - 1.0F;
+    depth = 2.0F * nearPlane * farPlane /
+            (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+  }
+
+  ivec2 size = textureSize(occlusionTexture, 0);
+  vec2 position = texCoords * vec2(size) - 0.5F;
+  ivec2 base = ivec2(floor(position));
+  vec2 f = fract(position);
+
+  float occlusion = 0.0F;
+  float weights = 0.0F;
+  for (int i = 0; i < 4; i++) {
+    ivec2 offset = ivec2(i & 1, i >> 1);
+    vec2 texel = texelFetch(occlusionTexture,
+                            clamp(base + offset, ivec2(0), size - 1), 0).rg;
+    vec2 bilinear = mix(1.0F - f, f, vec2(offset));
+    float weight = bilinear.x * bilinear.y /
+                   (1.0F + 50.0F * abs(texel.g - depth) / depth) + 1e-4F;
+    occlusion += texel.r * weight;
+    weights += weight;
+  }
+
+  return color * mix(1.0F, occlusion / weights, occlusionStrength);
+}
@@ -0,0 +1,12 @@
+// Adjusts saturation and contrast and tints the colors
+
+uniform float saturation;
+uniform float contrast;
+uniform vec3 tint;
+
+vec3 colorGrade(vec3 color) {
+  float luminance = dot(color, vec3(0.2126F, 0.7152F, 0.0722F));
+  color = mix(vec3(luminance), color, saturation);
+  color = (color - 0.5F) * contrast + 0.5F;
+  return clamp(color * tint, 0.0F, 1.0F);
+}
@@ -0,0 +1,51 @@
+#version 330 core
+
+// Screen-space ambient occlusion at reduced resolution
+#define SAMPLES 8
+
+// Specify the inputs to the fragment shader
+in vec2 texCoords;
+
+// Specify the Uniforms of the fragment shaders
+uniform sampler2D depthTexture;
+uniform float nearPlane;
+uniform float farPlane;
+uniform bool orthographic;
+uniform float occlusionRadius;
+// Horizontal and vertical focal length, in texture coordinates
+uniform vec2 focalLength;
+
+// Specify the output of the fragment shader: occlusion and linear depth, the
+// latter used to upsample without bleeding across edges
+out vec4 fColor;
+
+float linearDepth(vec2 coordinates) {
+  float depth = texture(depthTexture, coordinates).r;
+  if (orthographic) return mix(nearPlane, farPlane, depth);
+  float ndc = depth * 2.0F - 1.0F;
+  return 2.0F * nearPlane * farPlane /
+         (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+}
+
+void main() {
+  float depth = linearDepth(texCoords);
+
+  // Rotating the sample pattern per pixel trades banding for noise, which
+  // the upsample smooths out
+  float angle = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453) * 6.2831853;
+  // Orthographic views do not shrink with the distance
+  vec2 scale = occlusionRadius * focalLength / (orthographic ? 1.0F : depth);
+
+  float occlusion = 0.0F;
+  for (int i = 0; i < SAMPLES; i++) {
+    float a = angle + 6.2831853 * float(i) / float(SAMPLES);
+    float r = (float(i) + 0.5F) / float(SAMPLES);
+    vec2 offset = vec2(cos(a), sin(a)) * r * scale;
+    float difference = depth - linearDepth(texCoords + offset);
+    // Only nearby geometry in front of the pixel occludes it
+    occlusion += step(0.02F, difference) *
+                 (1.0F - smoothstep(0.0F, occlusionRadius, difference));
+  }
+
+  fColor = vec4(1.0F - occlusion / float(SAMPLES), depth, 0.0F, 1.0F);
+}
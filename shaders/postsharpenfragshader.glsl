@@ -0,0 +1,25 @@
+#version 330 core
+
+// Unsharp mask over the four direct neighbors; reads neighboring pixels, so it
+// cannot be fused with the per-pixel effects
+
+// Specify the inputs to the fragment shader
+in vec2 texCoords;
+
+// Specify the Uniforms of the fragment shaders
+uniform sampler2D inputTexture;
+uniform float sharpen;
+
+// Specify the output of the fragment shader
+out vec4 fColor;
+
+void main() {
+  // Offsets in texels of the input, which may differ in size from the target
+  vec2 texel = 1.0F / vec2(textureSize(inputTexture, 0));
+  vec3 center = texture(inputTexture, texCoords).rgb;
+  vec3 neighbors = texture(inputTexture, texCoords + vec2(texel.x, 0.0F)).rgb +
+                   texture(inputTexture, texCoords - vec2(texel.x, 0.0F)).rgb +
+                   texture(inputTexture, texCoords + vec2(0.0F, texel.y)).rgb +
+                   texture(inputTexture, texCoords - vec2(0.0F, texel.y)).rgb;
+  fColor = vec4(max(center + sharpen * (center - 0.25F * neighbors), 0.0F), 1.0F);
+}
@@ -0,0 +1,10 @@
+// Maps the floating-point scene colors to the displayable range (ACES fit)
+
+uniform float exposure;
+
+vec3 tonemap(vec3 color) {
+  color *= exposure;
+  return clamp(color * (2.51F * color + 0.03F) /
+                   (color * (2.43F * color + 0.59F) + 0.14F),
+               0.0F, 1.0F);
+}
@@ -0,0 +1,8 @@
+// Darkens the corners of the view
+
+uniform float vignette;
+
+vec3 vignetteEffect(vec3 color) {
+  vec2 fromCenter = texCoords - 0.5F;
+  return color * (1.0F - vignette * dot(fromCenter, fromCenter) * 2.0F);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth-only fragment shader, color writes are masked during the pre-pass
+
+void main() {
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+// Position-only vertex shader for the depth pre-pass
+
+// The attribute vertCoordinates_in is declared by the position format, see
+// vertex.h
+
+// Specify the Uniforms of the vertex shader
+uniform mat4 modelTransform;
+uniform mat4 viewTransform;
+uniform mat4 projectionTransform;
+
+// Must match the shading pass exactly for GL_LEQUAL to pass
+invariant gl_Position;
+
+void main() {
+  gl_Position = projectionTransform * viewTransform * modelTransform *
+                vec4(vertCoordinates_in, 1.0F);
+}
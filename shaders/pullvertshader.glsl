@@ -0,0 +1,66 @@
+#version 330 core
+
+// Vertex pulling: there are no attributes, every vertex of every node in the
+// draw is fetched from the vertex pool through the draw table
+
+// Specify the Uniforms of the vertex shader
+uniform samplerBuffer vertexData;      // floats of all vertices
+uniform usamplerBuffer indexData;      // indices of all elements
+uniform isamplerBuffer drawHeaders;    // one texel per node
+uniform samplerBuffer drawTransforms;  // four texels per node
+uniform int drawCount;
+uniform mat4 viewTransform;
+uniform mat4 projectionTransform;
+
+// Specify the output of the vertex stage
+out vec3 vertColor;
+out vec3 vertPosition;  // in view space, used for lighting
+
+invariant gl_Position;
+
+// First vertex in the draw, first float, first index (-1 if not indexed), and
+// stride and color offset + 1 of a node
+ivec4 header(int node) {
+  return texelFetch(drawHeaders, node);
+}
+
+void main() {
+  // The node of this vertex is the last one starting at or before it
+  int low = 0;
+  int high = drawCount - 1;
+  while (low < high) {
+    int middle = (low + high + 1) / 2;
+    if (header(middle).x <= gl_VertexID) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+  ivec4 node = header(low);
+
+  int element = gl_VertexID - node.x;
+  int vertex = node.z >= 0 ? int(texelFetch(indexData, node.z + element).r)
+                           : element;
+  int stride = node.w & 255;
+  int colorOffset = (node.w >> 8) - 1;
+  int base = node.y + vertex * stride;
+
+  vec3 position = vec3(texelFetch(vertexData, base).r,
+                       texelFetch(vertexData, base + 1).r,
+                       texelFetch(vertexData, base + 2).r);
+  // Meshes without stored colors derive them, as vertshader.glsl does
+  vertColor = abs(position);
+  if (colorOffset >= 0) {
+    vertColor = vec3(texelFetch(vertexData, base + colorOffset).r,
+                     texelFetch(vertexData, base + colorOffset + 1).r,
+                     texelFetch(vertexData, base + colorOffset + 2).r);
+  }
+
+  mat4 modelTransform = mat4(texelFetch(drawTransforms, 4 * low),
+                             texelFetch(drawTransforms, 4 * low + 1),
+                             texelFetch(drawTransforms, 4 * low + 2),
+                             texelFetch(drawTransforms, 4 * low + 3));
+  gl_Position = projectionTransform * viewTransform * modelTransform *
+                vec4(position, 1.0F);
+  vertPosition = (viewTransform * modelTransform * vec4(position, 1.0F)).xyz;
+}
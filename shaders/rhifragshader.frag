@@ -0,0 +1,13 @@
+#version 440
+
+// Fragment stage of the QRhi view, the same as fragshader.glsl
+
+// Specify the inputs to the fragment shader
+layout(location = 0) in vec3 vertColor;
+
+// Specify the output of the fragment shader
+layout(location = 0) out vec4 fColor;
+
+void main() {
+  fColor = vec4(vertColor, 1.0F);
+}
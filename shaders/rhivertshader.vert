@@ -0,0 +1,22 @@
+#version 440
+
+// Vertex stage of the QRhi view, compiled to every backend by qsb; the same
+// shading as vertshader.glsl
+
+// Specify the input locations of attributes
+layout(location = 0) in vec3 vertCoordinates_in;
+layout(location = 1) in vec3 vertColor_in;
+
+// Transformations of the drawn node, at a dynamic offset
+layout(std140, binding = 0) uniform Transforms {
+  mat4 modelTransform;
+  mat4 projectionTransform;
+};
+
+// Specify the output of the vertex stage
+layout(location = 0) out vec3 vertColor;
+
+void main() {
+  gl_Position = projectionTransform * modelTransform * vec4(vertCoordinates_in, 1.0F);
+  vertColor = vertColor_in;
+}
@@ -0,0 +1,101 @@
+#version 330 core
+
+// Feature switches, defined by the variant being built: clustered lighting,
+// and the shadows of the lights with a cached shadow map on top of it
+#pragma feature LIGHTING
+#pragma feature SHADOWS
+
+// Ambient light, so unlit surfaces keep their shape
+#define AMBIENT 0.15
+
+// Specify the inputs to the fragment shader
+in vec3 vertColor;
+in vec3 vertPosition;
+
+// Specify the output of the fragment shader
+out vec4 fColor;
+
+#ifdef LIGHTING
+// Specify the Uniforms of the fragment shaders
+// Two texels per light: position and radius, then color
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightIndices;
+// Offset and count in lightIndices of every cluster
+uniform usamplerBuffer clusterGrid;
+
+uniform ivec3 gridSize;
+uniform vec2 viewportSize;
+uniform float nearPlane;
+uniform float farPlane;
+#endif
+
+#ifdef SHADOWS
+// Lights with a cached shadow map; the cosine of the cone is below -1 for
+// directional lights
+#define MAX_SHADOW_LIGHTS 2
+uniform mat4 shadowTransforms[MAX_SHADOW_LIGHTS];
+uniform vec3 shadowLightPositions[MAX_SHADOW_LIGHTS];
+uniform vec3 shadowLightDirections[MAX_SHADOW_LIGHTS];
+uniform float shadowLightCosAngles[MAX_SHADOW_LIGHTS];
+uniform vec3 shadowLightColors[MAX_SHADOW_LIGHTS];
+uniform sampler2DShadow shadowMap0;
+uniform sampler2DShadow shadowMap1;
+
+// Fraction of the light reaching the fragment, filtered over 2x2 texels
+float shadowFactor(sampler2DShadow shadowMap, mat4 shadowTransform) {
+  vec4 coordinates = shadowTransform * vec4(vertPosition, 1.0F);
+  if (coordinates.w <= 0.0F) return 0.0F;
+  return texture(shadowMap, coordinates.xyz / coordinates.w);
+}
+
+vec3 shadowLight(int i, vec3 normal, float visibility) {
+  vec3 toLight = -shadowLightDirections[i];
+  float attenuation = 1.0F;
+  if (shadowLightCosAngles[i] >= -1.0F) {
+    toLight = normalize(shadowLightPositions[i] - vertPosition);
+    float cosAngle = dot(-toLight, shadowLightDirections[i]);
+    float inner = mix(shadowLightCosAngles[i], 1.0F, 0.1F);
+    attenuation = smoothstep(shadowLightCosAngles[i], inner, cosAngle);
+  }
+  return shadowLightColors[i] * max(dot(normal, toLight), 0.0F) * attenuation *
+         visibility;
+}
+#endif
+
+void main() {
+#ifdef LIGHTING
+  // Flat normal of the triangle, so no normals need to be stored
+  vec3 normal = normalize(cross(dFdx(vertPosition), dFdy(vertPosition)));
+
+  // Screen tile, and exponentially spaced depth slice
+  ivec3 cluster;
+  cluster.xy = ivec2(gl_FragCoord.xy / viewportSize * vec2(gridSize.xy));
+  cluster.z = int(log(-vertPosition.z / nearPlane) / log(farPlane / nearPlane) *
+                  float(gridSize.z));
+  cluster = clamp(cluster, ivec3(0), gridSize - 1);
+  int index = (cluster.z * gridSize.y + cluster.y) * gridSize.x + cluster.x;
+  uvec2 range = texelFetch(clusterGrid, index).rg;
+
+  vec3 lighting = vec3(AMBIENT);
+  for (uint i = 0u; i < range.y; i++) {
+    int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+    vec4 positionRadius = texelFetch(lightData, 2 * light);
+    vec3 color = texelFetch(lightData, 2 * light + 1).rgb;
+
+    vec3 toLight = positionRadius.xyz - vertPosition;
+    float distance = length(toLight);
+    float attenuation = clamp(1.0F - distance / positionRadius.w, 0.0F, 1.0F);
+    lighting += color * max(dot(normal, toLight / distance), 0.0F) *
+                attenuation * attenuation;
+  }
+
+#ifdef SHADOWS
+  lighting += shadowLight(0, normal, shadowFactor(shadowMap0, shadowTransforms[0]));
+  lighting += shadowLight(1, normal, shadowFactor(shadowMap1, shadowTransforms[1]));
+#endif
+
+  fColor = vec4(vertColor * lighting, 1.0F);
+#else
+  fColor = vec4(vertColor, 1.0F);
+#endif
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+// Bilinear upscale of the scene from its internal resolution to the widget
+
+// Specify the inputs to the fragment shader
+in vec2 texCoords;
+
+// Specify the Uniforms of the fragment shaders
+uniform sampler2D inputTexture;
+
+// Specify the output of the fragment shader
+out vec4 fColor;
+
+void main() {
+  fColor = vec4(texture(inputTexture, texCoords).rgb, 1.0F);
+}
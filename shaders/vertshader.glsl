@@ -3,22 +3,34 @@
 // Define constants
 #define M_PI 3.141593
 
-// Specify the input locations of attributes
-layout(location = 0) in vec3 vertCoordinates_in;
-layout(location = 1) in vec3 vertColor_in;
+// The attributes vertCoordinates_in and vertColor_in are declared by the
+// vertex format of the meshes, see vertex.h. Position-only meshes store no
+// colors; they follow from the positions instead
+#pragma feature POSITION_ONLY
 
 // Specify the Uniforms of the vertex shader
 // uniform mat4 modelTransform; for example
 uniform mat4 modelTransform;
+uniform mat4 viewTransform;
 uniform mat4 projectionTransform;
 
 // Specify the output of the vertex stage
 out vec3 vertColor;
+out vec3 vertPosition;  // in view space, used for lighting
+
+// Must match the depth pre-pass exactly for GL_LEQUAL to pass
+invariant gl_Position;
 
 void main() {
   // gl_Position is the output (a vec4) of the vertex shader
   // Currently without any transformation
 
-  gl_Position = projectionTransform * modelTransform * vec4(vertCoordinates_in, 1.0F);
+  gl_Position = projectionTransform * viewTransform * modelTransform *
+                vec4(vertCoordinates_in, 1.0F);
+#ifdef POSITION_ONLY
+  vertColor = abs(vertCoordinates_in);
+#else
   vertColor = vertColor_in;
+#endif
+  vertPosition = (viewTransform * modelTransform * vec4(vertCoordinates_in, 1.0F)).xyz;
 }
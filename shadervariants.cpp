@@ -0,0 +1,146 @@
+#include "shadervariants.h"
+
+/**
+ * @brief ShaderVariants::ShaderVariants Reads the feature switches declared by
+ * a vertex and a fragment shader. No variants are built yet.
+ * @param vertexPath Path of the vertex shader.
+ * @param fragmentPath Path of the fragment shader.
+ * @param uniforms Names of the uniforms whose locations the variants resolve,
+ * see Variant::location().
+ * @param vertexInputs Declarations of the vertex shader inputs, see
+ * VertexFormat::declarations().
+ */
+ShaderVariants::ShaderVariants(const QString &vertexPath,
+                               const QString &fragmentPath,
+                               const QByteArrayList &uniforms,
+                               const QByteArray &vertexInputs)
+    : vertexPath(vertexPath),
+      fragmentPath(fragmentPath),
+      uniforms(uniforms),
+      vertexInputs(vertexInputs) {
+  readFeatures();
+}
+
+/**
+ * @brief ShaderVariants::stages Returns the stages every variant is built
+ * from.
+ * @return Vertex and fragment stage.
+ */
+QVector<ProgramCache::Stage> ShaderVariants::stages() const {
+  return {{QOpenGLShader::Vertex, vertexPath, vertexInputs},
+          {QOpenGLShader::Fragment, fragmentPath, QByteArray()}};
+}
+
+/**
+ * @brief ShaderVariants::readFeatures Collects the "#pragma feature" switches
+ * of both sources, in the order of declaration. Switches read before keep
+ * their bits, even if a source no longer declares them, so masks stay valid
+ * after a reload.
+ */
+void ShaderVariants::readFeatures() {
+  for (const QString &path : {vertexPath, fragmentPath}) {
+    for (const QByteArray &line : ProgramCache::loadSource(path).split('\n')) {
+      QByteArrayList tokens = line.simplified().split(' ');
+      if (tokens.size() >= 3 && tokens[0] == "#pragma" &&
+          tokens[1] == "feature" && !features.contains(tokens[2])) {
+        features.append(tokens[2]);
+      }
+    }
+  }
+  variants.resize(1 << features.size());
+}
+
+/**
+ * @brief ShaderVariants::featureBit Returns the bit of a feature in the masks
+ * of the variants. Callers look it up once and combine the bits of the
+ * enabled features for get().
+ * @param feature Name of the feature.
+ * @return Bit of the feature, 0 if the sources do not declare it.
+ */
+quint32 ShaderVariants::featureBit(const QByteArray &feature) const {
+  int index = features.indexOf(feature);
+  if (index < 0) {
+    qDebug() << ":: Unknown shader feature" << feature;
+    return 0;
+  }
+  return 1u << index;
+}
+
+/**
+ * @brief ShaderVariants::defines Returns the defines of the features in a
+ * mask, in the order of declaration, so the cache sees one source per
+ * variant.
+ * @param mask Bits of the enabled features.
+ * @return One #define line per enabled feature.
+ */
+QByteArray ShaderVariants::defines(quint32 mask) const {
+  QByteArray defines;
+  for (int i = 0; i < features.size(); i++) {
+    if (mask & (1u << i)) defines += "#define " + features[i] + "\n";
+  }
+  return defines;
+}
+
+/**
+ * @brief ShaderVariants::build Builds a variant through the cache and
+ * resolves its uniform locations.
+ * @param cache Cache the variant is built through.
+ * @param variant Variant to build into.
+ * @param mask Bits of the enabled features.
+ * @return Whether the variant linked.
+ */
+bool ShaderVariants::build(ProgramCache &cache, Variant *variant,
+                           quint32 mask) const {
+  bool linked = cache.build(variant->program, stages(), defines(mask));
+  variant->locations.clear();
+  for (const QByteArray &uniform : uniforms) {
+    variant->locations.append(variant->program.uniformLocation(uniform));
+  }
+  return linked;
+}
+
+/**
+ * @brief ShaderVariants::~ShaderVariants Deletes the built programs. A context
+ * of their group must be current.
+ */
+ShaderVariants::~ShaderVariants() { qDeleteAll(variants); }
+
+/**
+ * @brief ShaderVariants::get Returns the variant with the given features
+ * enabled, building it on first use.
+ * @param cache Cache the variant is built through.
+ * @param mask Bits of the enabled features, see featureBit().
+ * @return Variant, linked unless its sources failed to compile.
+ */
+ShaderVariants::Variant &ShaderVariants::get(ProgramCache &cache,
+                                             quint32 mask) {
+  Variant *&variant = variants[mask];
+  if (!variant) {
+    variant = new Variant;
+    build(cache, variant, mask);
+  }
+  return *variant;
+}
+
+/**
+ * @brief ShaderVariants::reload Rebuilds the variants built so far after one
+ * of the sources changed. A variant whose new sources do not compile is kept
+ * as it was; the others resolve their uniform locations again.
+ * @param cache Cache the variants are built through.
+ * @param path Path of the changed source; other paths are ignored.
+ */
+void ShaderVariants::reload(ProgramCache &cache, const QString &path) {
+  if (path != vertexPath && path != fragmentPath) return;
+  readFeatures();
+  for (quint32 mask = 0; mask < quint32(variants.size()); mask++) {
+    if (!variants[mask]) continue;
+    Variant *variant = new Variant;
+    if (build(cache, variant, mask)) {
+      delete variants[mask];
+      variants[mask] = variant;
+    } else {
+      qDebug() << ":: Keeping the previous variant";
+      delete variant;
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <QVector>
+
+#include "programcache.h"
+
+/**
+ * @brief The programs built from one pair of shader sources, one for every
+ * combination of their feature switches.
+ *
+ * A source declares its switches with "#pragma feature NAME" lines, which
+ * the GLSL compiler ignores. A variant is built by prepending a #define for
+ * each switch it enables, so features that are off are compiled out instead
+ * of being skipped by branches on uniforms at run time. Variants are built
+ * the first time they are requested, through the program cache. After an
+ * edit of a source, reload() rebuilds the variants built so far.
+ *
+ * Variants are requested by a mask with a bit per feature, see featureBit(),
+ * and kept in a table indexed by it. The uniforms the caller sets are named
+ * up front; every variant looks up their locations when linked, and they are
+ * then read by their index in that list. Neither takes strings per frame.
+ */
+class ShaderVariants {
+ public:
+  class Variant {
+   public:
+    QOpenGLShaderProgram program;
+
+    // Location of a uniform by its index in the names given to the
+    // ShaderVariants, -1 if the variant does not use it
+    GLint location(int uniform) const { return locations[uniform]; }
+
+   private:
+    friend class ShaderVariants;
+    QVector<GLint> locations;
+  };
+
+  ShaderVariants(const QString &vertexPath, const QString &fragmentPath,
+                 const QByteArrayList &uniforms,
+                 const QByteArray &vertexInputs = QByteArray());
+  ~ShaderVariants();
+
+  quint32 featureBit(const QByteArray &feature) const;
+  Variant &get(ProgramCache &cache, quint32 mask);
+  const QByteArrayList &getFeatures() const { return features; }
+
+  void reload(ProgramCache &cache, const QString &path);
+
+ private:
+  void readFeatures();
+
+  QVector<ProgramCache::Stage> stages() const;
+  QByteArray defines(quint32 mask) const;
+  bool build(ProgramCache &cache, Variant *variant, quint32 mask) const;
+
+  QString vertexPath;
+  QString fragmentPath;
+  QByteArrayList uniforms;
+  QByteArray vertexInputs;
+
+  // Switches declared by the sources, bit i of a mask for features[i], and
+  // the variants by their masks, null until built
+  QByteArrayList features;
+  QVector<Variant *> variants;
+};
+
+#endif  // SHADERVARIANTS_H
@@ -0,0 +1,177 @@
+#include "shadowmap.h"
+
+#include <cmath>
+
+/**
+ * @brief ShadowMap::initialize Creates the depth texture, set up for hardware
+ * depth comparison.
+ * @param gl OpenGL functions of the current context.
+ */
+void ShadowMap::initialize(QOpenGLFunctions_3_3_Core *gl) {
+  gl->glGenTextures(1, &depthTexture);
+  gl->glBindTexture(GL_TEXTURE_2D, depthTexture);
+  gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                   GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE,
+                      GL_COMPARE_REF_TO_TEXTURE);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+  // Everything outside of the map is lit
+  const GLfloat border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+  gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+  gl->glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+
+  lightDirty = true;
+  cached.clear();
+}
+
+/**
+ * @brief ShadowMap::destroy Deletes the depth texture.
+ * @param gl OpenGL functions of a current context of the group.
+ */
+void ShadowMap::destroy(QOpenGLFunctions_3_3_Core *gl) {
+  gl->glDeleteTextures(1, &depthTexture);
+  depthTexture = 0;
+}
+
+/**
+ * @brief ShadowMap::createFramebuffer Creates a framebuffer rendering into the
+ * depth texture, for the calling context.
+ * @param gl OpenGL functions of the current context.
+ * @return The framebuffer, to be deleted by the caller.
+ */
+GLuint ShadowMap::createFramebuffer(QOpenGLFunctions_3_3_Core *gl) const {
+  GLint previousFramebuffer;
+  gl->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  GLuint framebuffer;
+  gl->glGenFramebuffers(1, &framebuffer);
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                             depthTexture, 0);
+  gl->glDrawBuffer(GL_NONE);
+  gl->glReadBuffer(GL_NONE);
+  if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    qDebug() << ":: Shadow map framebuffer incomplete";
+  }
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  return framebuffer;
+}
+
+/**
+ * @brief ShadowMap::setLight Changes the light, which invalidates the map only
+ * if it differs from the current one.
+ * @param light The new light.
+ */
+void ShadowMap::setLight(const ShadowLight &light) {
+  if (!lightDirty && light == this->light) return;
+  this->light = light;
+  lightDirty = true;
+
+  QVector3D direction = light.direction.normalized();
+  QVector3D up = std::fabs(direction.y()) > 0.99f ? QVector3D(1, 0, 0)
+                                                  : QVector3D(0, 1, 0);
+  QMatrix4x4 view;
+  QMatrix4x4 lightProjection;
+  if (light.type == ShadowLight::Spot) {
+    view.lookAt(light.position, light.position + direction, up);
+    lightProjection.perspective(2.0f * light.angle, 1.0f, 0.1f, light.range);
+  } else {
+    // Looking at the region from outside; casters between it and the light
+    // are still inside the volume
+    float range = light.range;
+    view.lookAt(light.position - 2.0f * range * direction, light.position, up);
+    lightProjection.ortho(-range, range, -range, range, 0.1f, 3.0f * range);
+  }
+  viewProjection = lightProjection * view;
+  frustum = Frustum::fromMatrix(viewProjection);
+
+  // Mapping clip space [-1, 1] to texture coordinates and depth [0, 1]
+  QMatrix4x4 bias;
+  bias.translate(0.5f, 0.5f, 0.5f);
+  bias.scale(0.5f);
+  shadowTransform = bias * viewProjection;
+}
+
+/**
+ * @brief ShadowMap::update Re-renders the map if the light or any caster
+ * overlapping the light volume changed since the last render. Expects a
+ * position-only depth program to be bound.
+ * @param gl OpenGL functions of the current context.
+ * @param framebuffer Framebuffer of the calling context rendering into the map.
+ * @param casters Nodes that may cast shadows.
+ * @param meshes Meshes referenced by the nodes.
+ * @param modelLocation Location of the model transformation uniform.
+ * @param projectionLocation Location of the projection transformation uniform.
+ * @return Whether the map was re-rendered.
+ */
+bool ShadowMap::update(QOpenGLFunctions_3_3_Core *gl, GLuint framebuffer,
+                       const QVector<SceneNode *> &casters,
+                       const QVector<Mesh> &meshes, GLint modelLocation,
+                       GLint projectionLocation) {
+  QVector<SceneNode *> overlapping;
+  QVector<CasterState> states;
+  for (SceneNode *node : casters) {
+    if (frustum.intersects(node->worldBounds())) {
+      const Mesh &mesh = meshes[node->getMesh()];
+      overlapping.append(node);
+      states.append({mesh.positionVBO, mesh.count, node->worldTransform(),
+                     node->worldBounds()});
+    }
+  }
+
+  // A caster that moved, entered or left the volume changes the list
+  if (!lightDirty && states == cached) return false;
+
+  render(gl, framebuffer, overlapping, meshes, modelLocation,
+         projectionLocation);
+  cached = states;
+  lightDirty = false;
+  renderCount++;
+  return true;
+}
+
+/**
+ * @brief ShadowMap::render Draws the depth of the casters at full detail into
+ * the map. Restores the framebuffer and viewport afterwards.
+ * @param gl OpenGL functions of the current context.
+ * @param framebuffer Framebuffer of the calling context rendering into the map.
+ * @param overlapping Casters overlapping the light volume.
+ * @param meshes Meshes referenced by the casters.
+ * @param modelLocation Location of the model transformation uniform.
+ * @param projectionLocation Location of the projection transformation uniform.
+ */
+void ShadowMap::render(QOpenGLFunctions_3_3_Core *gl, GLuint framebuffer,
+                       const QVector<SceneNode *> &overlapping,
+                       const QVector<Mesh> &meshes, GLint modelLocation,
+                       GLint projectionLocation) {
+  GLint previousFramebuffer;
+  GLint previousViewport[4];
+  gl->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  gl->glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  gl->glViewport(0, 0, size, size);
+  gl->glClear(GL_DEPTH_BUFFER_BIT);
+
+  // Pushing the stored depth back against self-shadowing
+  gl->glEnable(GL_POLYGON_OFFSET_FILL);
+  gl->glPolygonOffset(2.0f, 4.0f);
+
+  gl->glUniformMatrix4fv(projectionLocation, 1, GL_FALSE,
+                         viewProjection.constData());
+  for (SceneNode *node : overlapping) {
+    const Mesh &mesh = meshes[node->getMesh()];
+    gl->glUniformMatrix4fv(modelLocation, 1, GL_FALSE,
+                           node->worldTransform().constData());
+    gl->glBindVertexArray(mesh.positionVAO);
+    gl->glDrawArrays(GL_TRIANGLES, 0, mesh.count);
+  }
+
+  gl->glDisable(GL_POLYGON_OFFSET_FILL);
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  gl->glViewport(previousViewport[0], previousViewport[1], previousViewport[2],
+                 previousViewport[3]);
+}
@@ -0,0 +1,102 @@
+#ifndef SHADOWMAP_H
+#define SHADOWMAP_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector3D>
+#include <QVector>
+
+#include "bounds.h"
+#include "mesh.h"
+#include "scenenode.h"
+
+// Defining a light that casts shadows, in world space
+struct ShadowLight {
+  enum Type { Directional, Spot };
+
+  Type type = Directional;
+  // Spot: position of the light; directional: center of the shadowed region
+  QVector3D position;
+  QVector3D direction{0, -1, 0};
+  // Spot: reach of the light; directional: radius of the shadowed region
+  float range = 10.0f;
+  // Spot: half angle of the cone, in degrees
+  float angle = 30.0f;
+  QVector3D color{1, 1, 1};
+
+  bool operator==(const ShadowLight &other) const {
+    return type == other.type && position == other.position &&
+           direction == other.direction && range == other.range &&
+           angle == other.angle && color == other.color;
+  }
+  bool operator!=(const ShadowLight &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Cached shadow map of a directional or spot light.
+ *
+ * The depth texture is only re-rendered when it would change: when the light
+ * changed, or when the set of casters overlapping the light volume changed.
+ * Casters are compared by the buffer, world transformation and world bounds
+ * of their meshes against those of the last render, so a static scene renders
+ * its shadows once.
+ *
+ * A map is rendered through a framebuffer created with createFramebuffer().
+ */
+class ShadowMap {
+ public:
+  static constexpr int size = 1024;
+
+  void initialize(QOpenGLFunctions_3_3_Core *gl);
+  void destroy(QOpenGLFunctions_3_3_Core *gl);
+  GLuint createFramebuffer(QOpenGLFunctions_3_3_Core *gl) const;
+
+  void setLight(const ShadowLight &light);
+  const ShadowLight &getLight() const { return light; }
+
+  bool update(QOpenGLFunctions_3_3_Core *gl, GLuint framebuffer,
+              const QVector<SceneNode *> &casters, const QVector<Mesh> &meshes,
+              GLint modelLocation, GLint projectionLocation);
+
+  // Transformation from world space to shadow map coordinates and depth
+  const QMatrix4x4 &getShadowTransform() const { return shadowTransform; }
+  GLuint getDepthTexture() const { return depthTexture; }
+  qint64 getAllocatedBytes() const {
+    return depthTexture ? qint64(size) * size * 4 : 0;
+  }
+  int getRenderCount() const { return renderCount; }
+
+ private:
+  struct CasterState {
+    GLuint buffer;
+    GLsizei count;
+    QMatrix4x4 transform;
+    AABB bounds;
+
+    bool operator==(const CasterState &other) const {
+      return buffer == other.buffer && count == other.count &&
+             transform == other.transform &&
+             bounds.lower == other.bounds.lower &&
+             bounds.upper == other.bounds.upper;
+    }
+  };
+
+  void render(QOpenGLFunctions_3_3_Core *gl, GLuint framebuffer,
+              const QVector<SceneNode *> &overlapping,
+              const QVector<Mesh> &meshes, GLint modelLocation,
+              GLint projectionLocation);
+
+  ShadowLight light;
+  bool lightDirty = true;
+  QMatrix4x4 viewProjection;
+  QMatrix4x4 shadowTransform;
+  Frustum frustum;
+
+  // Casters at the last render
+  QVector<CasterState> cached;
+  int renderCount = 0;
+
+  GLuint depthTexture = 0;
+};
+
+#endif  // SHADOWMAP_H
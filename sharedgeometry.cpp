@@ -0,0 +1,87 @@
+#include "sharedgeometry.h"
+
+QHash<QOpenGLContextGroup *, SharedGeometry *> SharedGeometry::groups;
+
+/**
+ * @brief SharedGeometry::acquire Returns the shared geometry of the group of a
+ * context, creating it empty for the first view of the group.
+ * @param context Context of the calling view.
+ * @return Shared geometry, to be released by the view.
+ */
+SharedGeometry *SharedGeometry::acquire(QOpenGLContext *context) {
+  QOpenGLContextGroup *group = context->shareGroup();
+  SharedGeometry *shared = groups.value(group);
+  if (!shared) {
+    shared = new SharedGeometry;
+    shared->group = group;
+    groups.insert(group, shared);
+  }
+  shared->references++;
+  return shared;
+}
+
+/**
+ * @brief SharedGeometry::sceneUniforms Returns the names of the uniforms of
+ * the scene programs, in the order of SceneUniform.
+ * @return Names of the uniforms.
+ */
+QByteArrayList SharedGeometry::sceneUniforms() {
+  QByteArrayList names = {"projectionTransform", "viewTransform",
+                          "modelTransform",      "lightData",
+                          "lightIndices",        "clusterGrid",
+                          "gridSize",            "viewportSize",
+                          "nearPlane",           "farPlane"};
+  for (const char *array : {"shadowTransforms", "shadowLightPositions",
+                            "shadowLightDirections", "shadowLightCosAngles",
+                            "shadowLightColors"}) {
+    for (int i = 0; i < maxShadowLights; i++) {
+      names.append(array + ("[" + QByteArray::number(i) + "]"));
+    }
+  }
+  for (int i = 0; i < maxShadowLights; i++) {
+    names.append("shadowMap" + QByteArray::number(i));
+  }
+  return names;
+}
+
+/**
+ * @brief SharedGeometry::beginFrame Registers that a view starts drawing. If
+ * it already drew in the current frame of the group, that frame ends: the
+ * memory budget evicts what none of the views used in it, and the next frame
+ * starts.
+ * @param gl OpenGL functions of the current context.
+ * @param view The view.
+ */
+void SharedGeometry::beginFrame(QOpenGLFunctions_3_3_Core *gl, const void *view) {
+  if (frameViews.contains(view)) {
+    memoryBudget.endFrame(gl);
+    frame++;
+    frameViews.clear();
+  }
+  frameViews.insert(view);
+}
+
+/**
+ * @brief SharedGeometry::release Drops a reference to the shared geometry,
+ * deleting its buffers and programs after the last one. A context of the group
+ * must be current.
+ * @param gl OpenGL functions of the current context.
+ */
+void SharedGeometry::release(QOpenGLFunctions_3_3_Core *gl) {
+  if (--references > 0) return;
+
+  for (Mesh &mesh : meshes) {
+    if (!mesh.positionOnly) gl->glDeleteBuffers(1, &mesh.vbo);
+    gl->glDeleteBuffers(1, &mesh.ebo);
+    gl->glDeleteBuffers(1, &mesh.positionVBO);
+  }
+  vertexPool.destroy(gl);
+  lightClusters.destroy(gl);
+  instances.destroy(gl);
+  knotImpostor.destroy(gl);
+  particles.destroy(gl);
+  postPrograms.destroy();
+  delete assetWatcher;
+  groups.remove(group);
+  delete this;
+}
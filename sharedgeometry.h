@@ -0,0 +1,137 @@
+#ifndef SHAREDGEOMETRY_H
+#define SHAREDGEOMETRY_H
+
+#include <QHash>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QSet>
+#include <QVector3D>
+#include <QVector>
+
+#include "assetwatcher.h"
+#include "impostoratlas.h"
+#include "instanceculler.h"
+#include "lightclusters.h"
+#include "memorybudget.h"
+#include "mesh.h"
+#include "particlesystem.h"
+#include "postchain.h"
+#include "programcache.h"
+#include "shadervariants.h"
+#include "vertex.h"
+#include "vertexpool.h"
+
+/**
+ * @brief Meshes and programs shared by all views of one OpenGL context group.
+ *
+ * Buffers, textures and programs can be used by every context of a share
+ * group, vertex arrays, framebuffers and queries cannot. The first view of a
+ * group uploads the meshes and compiles the programs; the others only create
+ * vertex arrays for the uploaded buffers. The same holds for the lighting, the
+ * instance field, the post-processing programs and the particles below. The
+ * objects are deleted when the last view releases the group.
+ *
+ * As any view may be the one calling, the objects below do not keep OpenGL
+ * functions, but take those of the current context with every call that needs
+ * them. Each view creates the vertex arrays, framebuffers and queries for them
+ * that it needs.
+ */
+class SharedGeometry {
+ public:
+  static SharedGeometry *acquire(QOpenGLContext *context);
+  void release(QOpenGLFunctions_3_3_Core *gl);
+
+  bool isEmpty() const { return meshes.isEmpty(); }
+
+  // Frames of the group: one ends when a view that already drew in it starts
+  // drawing again, so each view draws at most once per frame
+  void beginFrame(QOpenGLFunctions_3_3_Core *gl, const void *view);
+  void removeView(const void *view) { frameViews.remove(view); }
+  quint64 getFrame() const { return frame; }
+
+  // Uploaded meshes; their vertex arrays are left 0, as every context needs
+  // its own
+  QVector<Mesh> meshes;
+
+  // Object-space triangles of the meshes that occlude in software, by mesh
+  QHash<int, QVector<QVector3D>> occluderCoords;
+  QHash<int, QVector<unsigned>> occluderIndices;
+
+  // The meshes again, in texture buffers for vertex pulling
+  VertexPool vertexPool;
+
+  // GPU memory of the meshes of all views, and of everything else below as
+  // pinned resources; the vertex pool and the light clusters change in size
+  MemoryBudget memoryBudget;
+  int poolResource = -1;
+  int clusterResource = -1;
+
+  // Builds the programs below, from binaries stored by an earlier run where
+  // possible
+  ProgramCache programCache;
+
+  // Uniforms of the programs below, as indices into sceneUniforms(); the
+  // arrays of the shadow lights take one index per light
+  static constexpr int maxShadowLights = 2;
+  enum SceneUniform {
+    ProjectionUniform,
+    ViewUniform,
+    ModelUniform,
+    LightDataUniform,
+    LightIndicesUniform,
+    ClusterGridUniform,
+    GridSizeUniform,
+    ViewportSizeUniform,
+    NearPlaneUniform,
+    FarPlaneUniform,
+    ShadowTransformUniforms,
+    ShadowLightPositionUniforms = ShadowTransformUniforms + maxShadowLights,
+    ShadowLightDirectionUniforms = ShadowLightPositionUniforms + maxShadowLights,
+    ShadowLightCosAngleUniforms = ShadowLightDirectionUniforms + maxShadowLights,
+    ShadowLightColorUniforms = ShadowLightCosAngleUniforms + maxShadowLights,
+    ShadowMapUniforms = ShadowLightColorUniforms + maxShadowLights
+  };
+  static QByteArrayList sceneUniforms();
+
+  // Programs shading the scene from vertex arrays and by vertex pulling, in
+  // variants for the lighting features
+  ShaderVariants sceneShaders{":/shaders/vertshader.glsl",
+                              ":/shaders/scenefragshader.glsl",
+                              sceneUniforms(), vertexFormat.declarations()};
+  ShaderVariants pullShaders{":/shaders/pullvertshader.glsl",
+                             ":/shaders/scenefragshader.glsl", sceneUniforms()};
+
+  QOpenGLShaderProgram prepassProgram;
+  QOpenGLShaderProgram depthViewProgram;
+  QOpenGLShaderProgram upscaleProgram;
+
+  // Light clusters, assigned by every view before it draws
+  LightClusters lightClusters;
+
+  // Knot instances with their impostor, and the particles, created when a
+  // view first shows them
+  InstanceCuller::Shared instances;
+  ImpostorAtlas knotImpostor;
+  ParticleSystem particles;
+
+  PostChain::Shared postPrograms;
+
+  // Development mode only: reports edited assets. The last change handled
+  // for the group, and a count of the reloads of the meshes above, which the
+  // views compare with their copies
+  AssetWatcher *assetWatcher = nullptr;
+  int handledChange = 0;
+  int meshGeneration = 0;
+
+ private:
+  QOpenGLContextGroup *group = nullptr;
+  int references = 0;
+
+  quint64 frame = 0;
+  QSet<const void *> frameViews;  // views that drew in this frame
+
+  static QHash<QOpenGLContextGroup *, SharedGeometry *> groups;
+};
+
+#endif  // SHAREDGEOMETRY_H
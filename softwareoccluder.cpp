@@ -0,0 +1,307 @@
+#include "softwareoccluder.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUDER_SSE
+#endif
+
+namespace {
+
+// Number of triangles set up before they are rasterized and the budget checked
+const int batchSize = 4096;
+
+}  // namespace
+
+/**
+ * @brief SoftwareOccluder::SoftwareOccluder Constructs an occluder with an
+ * empty depth buffer and one raster band per hardware thread.
+ */
+SoftwareOccluder::SoftwareOccluder()
+    : depth(width * height, 1.0F), tileDepth(tilesX * tilesY, 1.0F) {
+  int bands = qBound(1, QThread::idealThreadCount(), tilesY);
+  bandHeight = (tilesY + bands - 1) / bands * tileSize;
+  pool.setMaxThreadCount(bands);
+}
+
+/**
+ * @brief SoftwareOccluder::addOccluder Registers the geometry of an occluder,
+ * for example the data of a Model.
+ * @param coords Unique vertex coordinates, see Model::getCoords().
+ * @param indices Triangle indices, see Model::getTriangleIndices().
+ * @return Index of the occluder, to be used with addInstance().
+ */
+int SoftwareOccluder::addOccluder(const QVector<QVector3D> &coords,
+                                  const QVector<unsigned> &indices) {
+  Occluder occluder;
+  occluder.coords = coords;
+  occluder.indices = indices;
+  occluder.bounds = AABB::fromPoints(coords);
+  occluders.append(occluder);
+  return occluders.size() - 1;
+}
+
+/**
+ * @brief SoftwareOccluder::setOccluder Replaces the geometry of an occluder,
+ * for example after its model was edited.
+ * @param occluder Index returned by addOccluder().
+ * @param coords Vertex coordinates.
+ * @param indices Triangle indices into the coordinates.
+ */
+void SoftwareOccluder::setOccluder(int occluder,
+                                   const QVector<QVector3D> &coords,
+                                   const QVector<unsigned> &indices) {
+  Occluder &o = occluders[occluder];
+  o.coords = coords;
+  o.indices = indices;
+  o.bounds = AABB::fromPoints(coords);
+}
+
+/**
+ * @brief SoftwareOccluder::beginFrame Starts a new frame.
+ * @param viewProjection Transformation from world space to clip space.
+ */
+void SoftwareOccluder::beginFrame(const QMatrix4x4 &viewProjection) {
+  this->viewProjection = viewProjection;
+  instances.clear();
+}
+
+/**
+ * @brief SoftwareOccluder::addInstance Adds an instance of an occluder to be
+ * rasterized this frame.
+ * @param occluder Index returned by addOccluder().
+ * @param modelTransform Transformation from object space to world space.
+ */
+void SoftwareOccluder::addInstance(int occluder,
+                                   const QMatrix4x4 &modelTransform) {
+  // Estimating the projected area, so the largest occluders go first
+  AABB bounds = occluders[occluder].bounds.transformed(modelTransform);
+  QVector4D center = viewProjection * QVector4D(bounds.center(), 1.0F);
+  float w = std::fmax(center.w(), 1e-3F);
+  float priority = bounds.radius() * bounds.radius() / (w * w);
+
+  instances.append({occluder, viewProjection * modelTransform, priority});
+}
+
+/**
+ * @brief SoftwareOccluder::rasterize Clears the depth buffer and rasterizes the
+ * instances added this frame, in batches, until the time budget runs out.
+ */
+void SoftwareOccluder::rasterize() {
+  QElapsedTimer timer;
+  timer.start();
+
+  std::fill(depth.begin(), depth.end(), 1.0F);
+  rasterizedTriangles = 0;
+
+  std::sort(instances.begin(), instances.end(),
+            [](const Instance &l, const Instance &r) {
+              return l.priority > r.priority;
+            });
+
+  int next = 0;
+  while (next < instances.size() && timer.nsecsElapsed() < budget) {
+    triangles.clear();
+    while (next < instances.size() && triangles.size() < batchSize) {
+      setupTriangles(instances[next++]);
+    }
+
+    for (int y = 0; y < height; y += bandHeight) {
+      int end = std::min(y + bandHeight, height);
+      pool.start([this, y, end] { rasterizeBand(y, end); });
+    }
+    pool.waitForDone();
+    rasterizedTriangles += triangles.size();
+  }
+
+  for (int y = 0; y < height; y += bandHeight) {
+    int end = std::min(y + bandHeight, height);
+    pool.start([this, y, end] { buildHierarchy(y, end); });
+  }
+  pool.waitForDone();
+}
+
+/**
+ * @brief SoftwareOccluder::setupTriangles Transforms an instance to screen
+ * space and computes the edge functions and depth plane of its front facing
+ * triangles. Triangles crossing the near plane are dropped, which only makes
+ * the occluder smaller.
+ * @param instance The instance.
+ */
+void SoftwareOccluder::setupTriangles(const Instance &instance) {
+  const Occluder &occluder = occluders[instance.occluder];
+
+  clipCoords.resize(occluder.coords.size());
+  for (int i = 0; i < occluder.coords.size(); i++) {
+    clipCoords[i] = instance.transform * QVector4D(occluder.coords[i], 1.0F);
+  }
+
+  for (int i = 0; i + 2 < occluder.indices.size(); i += 3) {
+    float x[3], y[3], z[3];
+    bool clipped = false;
+    for (int v = 0; v < 3; v++) {
+      const QVector4D &p = clipCoords[occluder.indices[i + v]];
+      if (p.w() <= 0.0F || p.z() < -p.w()) {
+        clipped = true;
+        break;
+      }
+      // Window coordinates with the origin in the bottom left, like OpenGL
+      x[v] = (p.x() / p.w() * 0.5F + 0.5F) * width;
+      y[v] = (p.y() / p.w() * 0.5F + 0.5F) * height;
+      z[v] = p.z() / p.w() * 0.5F + 0.5F;
+    }
+    if (clipped) continue;
+
+    // Twice the signed area, positive for counter-clockwise (front) faces
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area <= 0.0F) continue;
+
+    Triangle t;
+    t.minX = std::max(0, static_cast<int>(std::floor(std::min({x[0], x[1], x[2]})))) & ~3;
+    t.maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max({x[0], x[1], x[2]}))));
+    t.minY = std::max(0, static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))));
+    t.maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max({y[0], y[1], y[2]}))));
+    if (t.minX > t.maxX || t.minY > t.maxY) continue;
+
+    // Edge k is opposite to vertex k, so it doubles as its barycentric weight
+    for (int k = 0; k < 3; k++) {
+      int v0 = (k + 1) % 3;
+      int v1 = (k + 2) % 3;
+      t.a[k] = y[v0] - y[v1];
+      t.b[k] = x[v1] - x[v0];
+      t.c[k] = -(t.a[k] * x[v0] + t.b[k] * y[v0]);
+    }
+    t.zx = (t.a[0] * z[0] + t.a[1] * z[1] + t.a[2] * z[2]) / area;
+    t.zy = (t.b[0] * z[0] + t.b[1] * z[1] + t.b[2] * z[2]) / area;
+    t.z0 = (t.c[0] * z[0] + t.c[1] * z[1] + t.c[2] * z[2]) / area;
+
+    triangles.append(t);
+  }
+}
+
+/**
+ * @brief SoftwareOccluder::rasterizeBand Rasterizes the current batch of
+ * triangles into the rows [bandStart, bandEnd) of the depth buffer. Bands do
+ * not overlap, so they can be rasterized concurrently.
+ * @param bandStart First row of the band.
+ * @param bandEnd Row after the last row of the band.
+ */
+void SoftwareOccluder::rasterizeBand(int bandStart, int bandEnd) {
+  for (const Triangle &t : triangles) {
+    int minY = std::max(t.minY, bandStart);
+    int maxY = std::min(t.maxY, bandEnd - 1);
+
+    for (int y = minY; y <= maxY; y++) {
+      float py = y + 0.5F;
+      float *row = depth.data() + y * width;
+
+#ifdef OCCLUDER_SSE
+      const __m128 offsets = _mm_setr_ps(0.5F, 1.5F, 2.5F, 3.5F);
+      const __m128 zero = _mm_setzero_ps();
+      __m128 a0 = _mm_set1_ps(t.a[0]);
+      __m128 a1 = _mm_set1_ps(t.a[1]);
+      __m128 a2 = _mm_set1_ps(t.a[2]);
+      __m128 r0 = _mm_set1_ps(t.b[0] * py + t.c[0]);
+      __m128 r1 = _mm_set1_ps(t.b[1] * py + t.c[1]);
+      __m128 r2 = _mm_set1_ps(t.b[2] * py + t.c[2]);
+      __m128 zx = _mm_set1_ps(t.zx);
+      __m128 rz = _mm_set1_ps(t.zy * py + t.z0);
+
+      // minX is a multiple of 4 and width too, so 4 pixels always fit
+      for (int x = t.minX; x <= t.maxX; x += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+        __m128 inside = _mm_and_ps(
+            _mm_and_ps(_mm_cmpgt_ps(e0, zero), _mm_cmpgt_ps(e1, zero)),
+            _mm_cmpgt_ps(e2, zero));
+        if (_mm_movemask_ps(inside) == 0) continue;
+
+        __m128 z = _mm_add_ps(_mm_mul_ps(zx, px), rz);
+        __m128 old = _mm_loadu_ps(row + x);
+        __m128 nearest = _mm_min_ps(old, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                         _mm_andnot_ps(inside, old)));
+      }
+#else
+      for (int x = t.minX; x <= t.maxX; x++) {
+        float px = x + 0.5F;
+        if (t.a[0] * px + t.b[0] * py + t.c[0] <= 0.0F ||
+            t.a[1] * px + t.b[1] * py + t.c[1] <= 0.0F ||
+            t.a[2] * px + t.b[2] * py + t.c[2] <= 0.0F) {
+          continue;
+        }
+        row[x] = std::fmin(row[x], t.zx * px + t.zy * py + t.z0);
+      }
+#endif
+    }
+  }
+}
+
+/**
+ * @brief SoftwareOccluder::buildHierarchy Stores the farthest depth of every
+ * tile in the rows [bandStart, bandEnd).
+ * @param bandStart First row of the band, a multiple of the tile size.
+ * @param bandEnd Row after the last row of the band.
+ */
+void SoftwareOccluder::buildHierarchy(int bandStart, int bandEnd) {
+  for (int ty = bandStart / tileSize; ty < bandEnd / tileSize; ty++) {
+    for (int tx = 0; tx < tilesX; tx++) {
+      float farthest = 0.0F;
+      for (int y = ty * tileSize; y < (ty + 1) * tileSize; y++) {
+        const float *row = depth.constData() + y * width + tx * tileSize;
+        for (int x = 0; x < tileSize; x++) farthest = std::fmax(farthest, row[x]);
+      }
+      tileDepth[ty * tilesX + tx] = farthest;
+    }
+  }
+}
+
+/**
+ * @brief SoftwareOccluder::isVisible Tests the bounds of an object against the
+ * hierarchical depth buffer. Conservative: returns true unless every tile the
+ * bounds cover is closer than the nearest point of the bounds.
+ * @param worldBounds World-space bounds of the object.
+ * @return Whether the object may be visible.
+ */
+bool SoftwareOccluder::isVisible(const AABB &worldBounds) const {
+  if (worldBounds.isEmpty()) return false;
+
+  float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+  float nearest = FLT_MAX;
+  for (int i = 0; i < 8; i++) {
+    QVector3D corner((i & 1) ? worldBounds.upper.x() : worldBounds.lower.x(),
+                     (i & 2) ? worldBounds.upper.y() : worldBounds.lower.y(),
+                     (i & 4) ? worldBounds.upper.z() : worldBounds.lower.z());
+    QVector4D p = viewProjection * QVector4D(corner, 1.0F);
+
+    // Crossing the near plane, the projected bounds are meaningless
+    if (p.w() <= 0.0F || p.z() < -p.w()) return true;
+
+    float x = (p.x() / p.w() * 0.5F + 0.5F) * width;
+    float y = (p.y() / p.w() * 0.5F + 0.5F) * height;
+    minX = std::fmin(minX, x);
+    maxX = std::fmax(maxX, x);
+    minY = std::fmin(minY, y);
+    maxY = std::fmax(maxY, y);
+    nearest = std::fmin(nearest, p.z() / p.w() * 0.5F + 0.5F);
+  }
+
+  int x0 = std::max(0, static_cast<int>(minX) / tileSize);
+  int x1 = std::min(tilesX - 1, static_cast<int>(maxX) / tileSize);
+  int y0 = std::max(0, static_cast<int>(minY) / tileSize);
+  int y1 = std::min(tilesY - 1, static_cast<int>(maxY) / tileSize);
+  if (x0 > x1 || y0 > y1) return true;
+
+  for (int ty = y0; ty <= y1; ty++) {
+    for (int tx = x0; tx <= x1; tx++) {
+      if (tileDepth[ty * tilesX + tx] >= nearest) return true;
+    }
+  }
+  return false;
+}
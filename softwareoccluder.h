@@ -0,0 +1,92 @@
+#ifndef SOFTWAREOCCLUDER_H
+#define SOFTWAREOCCLUDER_H
+
+#include <QMatrix4x4>
+#include <QThreadPool>
+#include <QVector3D>
+#include <QVector4D>
+#include <QVector>
+
+#include "bounds.h"
+
+/**
+ * @brief A CPU rasterizer for conservative occlusion culling.
+ *
+ * Selected occluder meshes are rasterized into a low resolution depth buffer
+ * every frame, before anything is submitted to OpenGL. The screen is split in
+ * horizontal bands that are rasterized in parallel, four pixels at a time with
+ * SSE. Afterwards, the farthest depth of every tile is stored in a
+ * hierarchical depth buffer, against which the bounds of objects are tested.
+ *
+ * Occluders are rasterized largest on screen first, and rasterization stops
+ * once the time budget of the frame is used up. Skipping occluders only makes
+ * the test less effective, never wrong.
+ */
+class SoftwareOccluder {
+ public:
+  static constexpr int width = 256;
+  static constexpr int height = 144;
+  static constexpr int tileSize = 8;
+  static constexpr int tilesX = width / tileSize;
+  static constexpr int tilesY = height / tileSize;
+
+  SoftwareOccluder();
+
+  // Occluder geometry, as indexed triangles in object space
+  int addOccluder(const QVector<QVector3D> &coords,
+                  const QVector<unsigned> &indices);
+  void setOccluder(int occluder, const QVector<QVector3D> &coords,
+                   const QVector<unsigned> &indices);
+
+  void setBudget(qint64 nanoseconds) { budget = nanoseconds; }
+
+  // Per frame: add the occluder instances, rasterize, then test
+  void beginFrame(const QMatrix4x4 &viewProjection);
+  void addInstance(int occluder, const QMatrix4x4 &modelTransform);
+  void rasterize();
+  bool isVisible(const AABB &worldBounds) const;
+
+  // Depth buffer in window coordinates, bottom row first
+  const float *depthData() const { return depth.constData(); }
+  int getRasterizedTriangles() const { return rasterizedTriangles; }
+
+ private:
+  struct Occluder {
+    QVector<QVector3D> coords;
+    QVector<unsigned> indices;
+    AABB bounds;
+  };
+
+  struct Instance {
+    int occluder;
+    QMatrix4x4 transform;
+    float priority;
+  };
+
+  // Screen space triangle with its edge functions and depth plane
+  struct Triangle {
+    float a[3], b[3], c[3];
+    float zx, zy, z0;
+    int minX, maxX, minY, maxY;
+  };
+
+  void setupTriangles(const Instance &instance);
+  void rasterizeBand(int bandStart, int bandEnd);
+  void buildHierarchy(int bandStart, int bandEnd);
+
+  QVector<Occluder> occluders;
+  QVector<Instance> instances;
+  QVector<QVector4D> clipCoords;
+  QVector<Triangle> triangles;
+
+  QMatrix4x4 viewProjection;
+  QVector<float> depth;
+  QVector<float> tileDepth;
+
+  QThreadPool pool;
+  int bandHeight;
+  qint64 budget = 1000000;
+  int rasterizedTriangles = 0;
+};
+
+#endif  // SOFTWAREOCCLUDER_H
@@ -0,0 +1,132 @@
+#include "uploadworker.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+
+/**
+ * @brief UploadWorker::UploadWorker Creates the context of the worker, shared
+ * with that of the view, and starts the worker thread. Called on the GUI
+ * thread, which the offscreen surface must be created on.
+ * @param shareContext Context of the view.
+ * @param parent Parent object.
+ */
+UploadWorker::UploadWorker(QOpenGLContext *shareContext, QObject *parent)
+    : QObject(parent) {
+  context = new QOpenGLContext;
+  context->setFormat(shareContext->format());
+  context->setShareContext(shareContext);
+  if (!context->create()) qDebug() << ":: Could not create the upload context";
+
+  surface = new QOffscreenSurface;
+  surface->setFormat(context->format());
+  surface->create();
+
+  threadObject = new QObject;
+  threadObject->moveToThread(&thread);
+  context->moveToThread(&thread);
+  thread.start();
+}
+
+/**
+ * @brief UploadWorker::~UploadWorker Finishes the queued jobs and stops the
+ * thread. Buffers of assets that were not taken are deleted.
+ */
+UploadWorker::~UploadWorker() {
+  QThread *guiThread = QCoreApplication::instance()->thread();
+  QMetaObject::invokeMethod(
+      threadObject,
+      [this, guiThread] {
+        if (current) {
+          for (Resource &resource : finished) {
+            gl.glDeleteBuffers(resource.buffers.size(),
+                               resource.buffers.constData());
+          }
+          context->doneCurrent();
+        }
+        context->moveToThread(guiThread);
+      },
+      Qt::BlockingQueuedConnection);
+  thread.quit();
+  thread.wait();
+  delete threadObject;
+  delete context;
+  delete surface;
+}
+
+/**
+ * @brief UploadWorker::enqueue Queues the loading and upload of an asset.
+ * @param loader Produces the contents of the buffers; runs on the worker
+ * thread.
+ * @return Ticket identifying the asset in takeFinished().
+ */
+int UploadWorker::enqueue(Loader loader) {
+  int ticket = nextTicket++;
+  QMetaObject::invokeMethod(
+      threadObject, [this, ticket, loader] { process(ticket, loader); },
+      Qt::QueuedConnection);
+  return ticket;
+}
+
+/**
+ * @brief UploadWorker::takeFinished Returns the assets whose upload completed
+ * since the last call. Their buffers are owned by the caller from then on.
+ * @return Uploaded assets.
+ */
+QVector<UploadWorker::Resource> UploadWorker::takeFinished() {
+  QMutexLocker locker(&mutex);
+  QVector<Resource> resources = finished;
+  finished.clear();
+  return resources;
+}
+
+/**
+ * @brief UploadWorker::process Loads an asset and uploads its buffers, then
+ * publishes it once the GPU has completed the transfer. Runs on the worker
+ * thread.
+ * @param ticket Ticket of the asset.
+ * @param loader Produces the contents of the buffers.
+ */
+void UploadWorker::process(int ticket, const Loader &loader) {
+  if (!current) {
+    current = context->makeCurrent(surface);
+    if (!current) {
+      qDebug() << ":: Could not make the upload context current";
+      return;
+    }
+    gl.initializeOpenGLFunctions();
+  }
+
+  Asset asset = loader();
+
+  Resource resource;
+  resource.ticket = ticket;
+  resource.bounds = asset.bounds;
+  for (const QByteArray &data : asset.buffers) {
+    GLuint buffer;
+    gl.glGenBuffers(1, &buffer);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    gl.glBufferData(GL_ARRAY_BUFFER, data.size(), nullptr, GL_STATIC_DRAW);
+    for (GLsizeiptr offset = 0; offset < data.size(); offset += sliceSize) {
+      GLsizeiptr size = qMin<GLsizeiptr>(sliceSize, data.size() - offset);
+      gl.glBufferSubData(GL_ARRAY_BUFFER, offset, size, data.constData() + offset);
+      gl.glFlush();
+    }
+    resource.buffers.append(buffer);
+    resource.sizes.append(data.size());
+  }
+  gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // Handing the buffers over only after the GPU finished the transfer; this
+  // thread is the only one that waits
+  GLsync fence = gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  while (gl.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) ==
+         GL_TIMEOUT_EXPIRED) {
+  }
+  gl.glDeleteSync(fence);
+
+  {
+    QMutexLocker locker(&mutex);
+    finished.append(resource);
+  }
+  emit ready();
+}
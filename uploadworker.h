@@ -0,0 +1,76 @@
+#ifndef UPLOADWORKER_H
+#define UPLOADWORKER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QThread>
+#include <QVector>
+#include <functional>
+
+#include "bounds.h"
+
+/**
+ * @brief Loads assets and uploads their buffers on a thread of its own.
+ *
+ * The worker owns an OpenGL context shared with the view, current on an
+ * offscreen surface in the worker thread, so neither parsing nor copying to
+ * the GPU happens on the thread that paints. Buffers are filled in slices of
+ * a capped size, flushed one by one, so the driver never has to take one huge
+ * copy at once. After the last slice the worker inserts a fence and waits for
+ * it; only then is the asset published, so the view never draws or waits for
+ * a buffer that is still being transferred. Finished assets are collected by
+ * the view with takeFinished(), on its own thread, after the ready() signal.
+ */
+class UploadWorker : public QObject {
+  Q_OBJECT
+
+ public:
+  // Contents of the buffers of an asset and its bounds, produced on the
+  // worker thread
+  struct Asset {
+    QVector<QByteArray> buffers;
+    AABB bounds;
+  };
+  using Loader = std::function<Asset()>;
+
+  // Buffers of an asset, complete on the GPU and usable by the view
+  struct Resource {
+    int ticket;
+    QVector<GLuint> buffers;
+    QVector<GLsizeiptr> sizes;
+    AABB bounds;
+  };
+
+  explicit UploadWorker(QOpenGLContext *shareContext, QObject *parent = nullptr);
+  ~UploadWorker() override;
+
+  void setSliceSize(GLsizeiptr bytes) { sliceSize = bytes; }
+
+  int enqueue(Loader loader);
+  QVector<Resource> takeFinished();
+
+ signals:
+  void ready();
+
+ private:
+  void process(int ticket, const Loader &loader);
+
+  QThread thread;
+  QObject *threadObject;  // lives in the worker thread, runs the jobs
+  QOpenGLContext *context;
+  QOffscreenSurface *surface;
+  QOpenGLFunctions_3_3_Core gl;
+  bool current = false;
+
+  GLsizeiptr sliceSize = 1 << 20;  // bytes
+  int nextTicket = 0;
+
+  QMutex mutex;
+  QVector<Resource> finished;
+};
+
+#endif  // UPLOADWORKER_H
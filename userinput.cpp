@@ -10,16 +10,85 @@ void MainView::keyPressEvent(QKeyEvent *ev) {
   switch (ev->key()) {
     case 'A':
       qDebug() << "A pressed";
+      return;
+    case 'C':
+      continuousRendering = !continuousRendering;
+      if (continuousRendering) {
+        timer.start(16);
+      } else {
+        timer.stop();
+      }
+      qDebug() << "Continuous rendering" << (continuousRendering ? "on" : "off");
+      break;
+    case 'M':
+      morphing = !morphing;
+      qDebug() << "Knot animation" << (morphing ? "on" : "off");
+      break;
+    case 'N':
+      loadModelInBackground();
+      qDebug() << "Loading a model in the background";
+      return;
+    case 'O':
+      occlusionCulling = !occlusionCulling;
+      qDebug() << "Occlusion culling" << (occlusionCulling ? "on" : "off");
+      break;
+    case 'R':
+      dynamicResolution = !dynamicResolution;
+      qDebug() << "Dynamic resolution" << (dynamicResolution ? "on" : "off");
+      break;
+    case 'S':
+      softwareCulling = !softwareCulling;
+      qDebug() << "Software occlusion culling" << (softwareCulling ? "on" : "off");
+      break;
+    case 'D':
+      showOccluderDepth = !showOccluderDepth;
+      break;
+    case 'K':
+      clusteredLighting = !clusteredLighting;
+      qDebug() << "Clustered lighting" << (clusteredLighting ? "on" : "off");
+      break;
+    case 'H':
+      shadows = !shadows;
+      qDebug() << "Shadows" << (shadows ? "on" : "off");
+      break;
+    case 'L':
+      lodSelection = !lodSelection;
+      qDebug() << "Level of detail selection" << (lodSelection ? "on" : "off");
+      break;
+    case 'I':
+      showInstances = !showInstances;
+      break;
+    case 'G':
+      showParticles = !showParticles;
+      qDebug() << "Particles" << (showParticles ? "on" : "off");
+      break;
+    case 'P':
+      postProcessing = !postProcessing;
+      qDebug() << "Post-processing" << (postProcessing ? "on" : "off");
+      break;
+    case 'J':
+      sharpening = !sharpening;
+      makeCurrent();
+      updatePostEffects();
+      doneCurrent();
+      break;
+    case 'V':
+      vertexPulling = !vertexPulling;
+      qDebug() << "Vertex pulling" << (vertexPulling ? "on" : "off");
+      break;
+    case 'Z':
+      depthPrepass = !depthPrepass;
+      qDebug() << "Depth pre-pass" << (depthPrepass ? "on" : "off");
       break;
     default:
       // ev->key() is an integer. For alpha numeric characters keys it
       // equivalent with the char value ('A' == 65, '1' == 49) Alternatively,
       // you could use Qt Key enums, see http://doc.qt.io/qt-6/qt.html#Key-enum
       qDebug() << ev->key() << "pressed";
-      break;
+      return;
   }
-  // Used to update the screen after changes
-  update();
+  // Used to update the screen after changes; keys that only log return early
+  invalidate(SettingsDirty);
 }
 
 // Triggered by releasing a key
@@ -36,8 +105,6 @@ void MainView::keyReleaseEvent(QKeyEvent *ev) {
       qDebug() << ev->key() << "released";
       break;
   }
-
-  update();
 }
 
 /**
@@ -48,8 +115,6 @@ void MainView::keyReleaseEvent(QKeyEvent *ev) {
  */
 void MainView::mouseDoubleClickEvent(QMouseEvent *ev) {
   qDebug() << "Mouse double clicked:" << ev->button();
-
-  update();
 }
 
 /**
@@ -59,8 +124,6 @@ void MainView::mouseDoubleClickEvent(QMouseEvent *ev) {
  */
 void MainView::mouseMoveEvent(QMouseEvent *ev) {
   qDebug() << "x" << ev->position().x() << "y" << ev->position().y();
-
-  update();
 }
 
 /**
@@ -70,7 +133,6 @@ void MainView::mouseMoveEvent(QMouseEvent *ev) {
 void MainView::mousePressEvent(QMouseEvent *ev) {
   qDebug() << "Mouse button pressed:" << ev->button();
 
-  update();
   // Do not remove the line below, clicking must focus on this widget!
   this->setFocus();
 }
@@ -81,8 +143,6 @@ void MainView::mousePressEvent(QMouseEvent *ev) {
  */
 void MainView::mouseReleaseEvent(QMouseEvent *ev) {
   qDebug() << "Mouse button released" << ev->button();
-
-  update();
 }
 
 /**
@@ -93,6 +153,4 @@ void MainView::mouseReleaseEvent(QMouseEvent *ev) {
 void MainView::wheelEvent(QWheelEvent *ev) {
   // Implement something
   qDebug() << "Mouse wheel:" << ev->angleDelta();
-
-  update();
 }
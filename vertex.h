@@ -1,10 +1,27 @@
 #ifndef VERTEX_H
 #define VERTEX_H
 
+#include <cstddef>
+
+#include "vertexformat.h"
+
 // Defining a structure for the pyramid vertices
 struct Vertex{
     float x, y, z;
     float r, g, b;
 };
 
+// Attributes of Vertex, at locations 0 and 1 of the vertex shaders
+inline constexpr auto vertexFormat = makeVertexFormat<Vertex>(
+    attribute<GLfloat>("vertCoordinates_in", offsetof(Vertex, x), 3),
+    attribute<GLfloat>("vertColor_in", offsetof(Vertex, r), 3));
+
+// De-interleaved positions, as streamed for the depth pre-pass
+struct VertexPosition {
+  float x, y, z;
+};
+
+inline constexpr auto positionFormat = makeVertexFormat<VertexPosition>(
+    attribute<GLfloat>("vertCoordinates_in", offsetof(VertexPosition, x), 3));
+
 #endif // VERTEX_H
@@ -0,0 +1,237 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <QByteArray>
+#include <QDebug>
+#include <QOpenGLFunctions_3_3_Core>
+#include <array>
+#include <cstddef>
+
+// How the vertex shader receives the components: as floats converted from
+// the stored type, as integers or as floats normalized to [0, 1] or [-1, 1]
+enum class AttributeMode { Float, Normalized, Integer };
+
+// Component types beyond the scalars of OpenGL: half floats, and four
+// components packed into 32 bits as 10, 10, 10 and 2 bits
+struct HalfFloat {
+  GLushort bits;
+};
+struct PackedInt2101010 {
+  GLuint bits;
+};
+struct PackedUInt2101010 {
+  GLuint bits;
+};
+
+// OpenGL type of a component type; left undefined for unsupported types
+template <GLenum glType, bool isIntegral, bool isSignedType, bool isPacked>
+struct ComponentInfo {
+  static constexpr GLenum type = glType;
+  static constexpr bool integral = isIntegral;
+  static constexpr bool isSigned = isSignedType;
+  static constexpr bool packed = isPacked;
+};
+
+template <typename T>
+struct ComponentTraits;
+template <>
+struct ComponentTraits<GLfloat> : ComponentInfo<GL_FLOAT, false, true, false> {};
+template <>
+struct ComponentTraits<HalfFloat>
+    : ComponentInfo<GL_HALF_FLOAT, false, true, false> {};
+template <>
+struct ComponentTraits<GLbyte> : ComponentInfo<GL_BYTE, true, true, false> {};
+template <>
+struct ComponentTraits<GLubyte>
+    : ComponentInfo<GL_UNSIGNED_BYTE, true, false, false> {};
+template <>
+struct ComponentTraits<GLshort> : ComponentInfo<GL_SHORT, true, true, false> {};
+template <>
+struct ComponentTraits<GLushort>
+    : ComponentInfo<GL_UNSIGNED_SHORT, true, false, false> {};
+template <>
+struct ComponentTraits<GLint> : ComponentInfo<GL_INT, true, true, false> {};
+template <>
+struct ComponentTraits<GLuint>
+    : ComponentInfo<GL_UNSIGNED_INT, true, false, false> {};
+template <>
+struct ComponentTraits<PackedInt2101010>
+    : ComponentInfo<GL_INT_2_10_10_10_REV, false, true, true> {};
+template <>
+struct ComponentTraits<PackedUInt2101010>
+    : ComponentInfo<GL_UNSIGNED_INT_2_10_10_10_REV, false, false, true> {};
+
+struct VertexAttribute {
+  const char *name;  // of the input in the vertex shader
+  GLenum type;
+  GLint components;
+  AttributeMode mode;
+  std::size_t offset;     // bytes from the start of the vertex
+  std::size_t size;       // bytes
+  std::size_t alignment;  // bytes
+  bool integral;
+  bool isSigned;
+  bool packed;
+};
+
+/**
+ * @brief attribute Describes an attribute of a vertex struct.
+ * @param name Name of the input in the vertex shader.
+ * @param offset Offset in the struct, from offsetof().
+ * @param components Number of components; 4 for the packed types.
+ * @param mode How the shader receives the components.
+ * @return Description, checked when the format is built.
+ */
+template <typename T>
+constexpr VertexAttribute attribute(const char *name, std::size_t offset,
+                                    GLint components,
+                                    AttributeMode mode = AttributeMode::Float) {
+  using Traits = ComponentTraits<T>;
+  return {name,
+          Traits::type,
+          components,
+          mode,
+          offset,
+          Traits::packed ? sizeof(T) : components * sizeof(T),
+          alignof(T),
+          Traits::integral,
+          Traits::isSigned,
+          Traits::packed};
+}
+
+// Not constexpr: a format that reaches it during compilation does not compile
+inline void invalidVertexFormat(const char *reason) {
+  qDebug() << ":: Invalid vertex format:" << reason;
+}
+
+/**
+ * @brief Compile-time description of the layout of a vertex struct.
+ *
+ * A format lists the attributes of a vertex struct: the GLSL name, the
+ * component type and count, the offset in the struct and how the shader sees
+ * the values. From it follow the glVertexAttribPointer and
+ * glVertexAttribIPointer calls of a vertex array and the "in" declarations of
+ * the vertex shaders, so both always match the struct.
+ *
+ * Formats are meant to be constexpr variables, which makes the checks of
+ * their constructor part of compilation: attributes that overlap, leave the
+ * struct, are misaligned or combine a mode with a component type it cannot
+ * take stop the build, with the reason in the diagnostic.
+ */
+template <typename V, std::size_t N>
+class VertexFormat {
+ public:
+  static constexpr GLsizei stride = sizeof(V);
+
+  constexpr explicit VertexFormat(const std::array<VertexAttribute, N> &list)
+      : attributes(list) {
+    for (std::size_t i = 0; i < N; i++) {
+      const VertexAttribute &a = attributes[i];
+      if (a.components < 1 || a.components > 4) {
+        invalidVertexFormat("an attribute has 1 to 4 components");
+      }
+      if (a.packed && a.components != 4) {
+        invalidVertexFormat("packed attributes have 4 components");
+      }
+      if (a.offset + a.size > sizeof(V)) {
+        invalidVertexFormat("attribute extends past the end of the vertex");
+      }
+      if (a.offset % a.alignment != 0) {
+        invalidVertexFormat("attribute offset is not aligned to its type");
+      }
+      if (a.mode == AttributeMode::Integer && !a.integral) {
+        invalidVertexFormat("integer attributes need an integer type");
+      }
+      if (a.mode == AttributeMode::Normalized && !a.integral && !a.packed) {
+        invalidVertexFormat("normalized attributes need an integer type");
+      }
+      for (std::size_t j = 0; j < i; j++) {
+        const VertexAttribute &b = attributes[j];
+        if (a.offset < b.offset + b.size && b.offset < a.offset + a.size) {
+          invalidVertexFormat("attributes overlap");
+        }
+      }
+    }
+  }
+
+  constexpr std::size_t size() const { return N; }
+  constexpr const VertexAttribute &operator[](std::size_t i) const {
+    return attributes[i];
+  }
+
+  /**
+   * @brief VertexFormat::specify Enables every attribute of the format in
+   * the bound vertex array, reading from the bound GL_ARRAY_BUFFER.
+   * @param gl OpenGL functions of the current context.
+   * @param firstLocation Location of the first attribute; the others follow.
+   */
+  void specify(QOpenGLFunctions_3_3_Core *gl, GLuint firstLocation = 0) const {
+    for (std::size_t i = 0; i < N; i++) {
+      specifyAttribute(gl, i, firstLocation + GLuint(i));
+    }
+  }
+
+  /**
+   * @brief VertexFormat::specifyAttribute Enables one attribute of the format
+   * in the bound vertex array, reading from the bound GL_ARRAY_BUFFER.
+   * @param gl OpenGL functions of the current context.
+   * @param index Index of the attribute in the format.
+   * @param location Location of the attribute in the vertex shader.
+   */
+  void specifyAttribute(QOpenGLFunctions_3_3_Core *gl, std::size_t index,
+                        GLuint location) const {
+    const VertexAttribute &a = attributes[index];
+    const void *pointer = reinterpret_cast<const void *>(a.offset);
+    gl->glEnableVertexAttribArray(location);
+    if (a.mode == AttributeMode::Integer) {
+      gl->glVertexAttribIPointer(location, a.components, a.type, stride,
+                                 pointer);
+    } else {
+      GLboolean normalized = a.mode == AttributeMode::Normalized;
+      gl->glVertexAttribPointer(location, a.components, a.type, normalized,
+                                stride, pointer);
+    }
+  }
+
+  /**
+   * @brief VertexFormat::declarations Returns the inputs of a vertex shader
+   * reading the format, to be inserted after its #version line.
+   * @param firstLocation Location of the first attribute, as in specify().
+   * @return One "layout(location = ...) in" declaration per attribute.
+   */
+  QByteArray declarations(GLuint firstLocation = 0) const {
+    QByteArray lines;
+    for (std::size_t i = 0; i < N; i++) {
+      const VertexAttribute &a = attributes[i];
+      QByteArray type;
+      if (a.mode != AttributeMode::Integer) {
+        type = a.components == 1 ? "float" : "vec";
+      } else {
+        type = a.components == 1 ? (a.isSigned ? "int" : "uint")
+                                 : (a.isSigned ? "ivec" : "uvec");
+      }
+      if (a.components > 1) type += QByteArray::number(a.components);
+      lines += "layout(location = " + QByteArray::number(firstLocation + i) +
+               ") in " + type + " " + a.name + ";\n";
+    }
+    return lines;
+  }
+
+ private:
+  std::array<VertexAttribute, N> attributes;
+};
+
+/**
+ * @brief makeVertexFormat Builds the format of a vertex struct; declare the
+ * result constexpr to check it at compile time.
+ * @param attributes Descriptions from attribute(), in location order.
+ * @return Format of the struct.
+ */
+template <typename V, typename... Attributes>
+constexpr VertexFormat<V, sizeof...(Attributes)> makeVertexFormat(
+    const Attributes &...attributes) {
+  return VertexFormat<V, sizeof...(Attributes)>(
+      std::array<VertexAttribute, sizeof...(Attributes)>{{attributes...}});
+}
+
+#endif  // VERTEXFORMAT_H
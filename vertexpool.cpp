@@ -0,0 +1,92 @@
+#include "vertexpool.h"
+
+#include <QDebug>
+#include <cstddef>
+
+#include "vertex.h"
+
+/**
+ * @brief VertexPool::build Copies the vertices and elements of the meshes into
+ * the pool, without a round trip through the CPU.
+ * @param gl OpenGL functions of the current context.
+ * @param meshes Uploaded meshes, with interleaved Vertex data or positions
+ * only.
+ */
+void VertexPool::build(QOpenGLFunctions_3_3_Core *gl,
+                       const QVector<Mesh> &meshes) {
+  ranges.clear();
+  GLsizeiptr vertexBytes = 0;
+  GLsizeiptr indexBytes = 0;
+  QVector<GLint> elementBytes;
+  for (const Mesh &mesh : meshes) {
+    Range range;
+    GLsizeiptr vertexSize =
+        mesh.positionOnly ? sizeof(VertexPosition) : sizeof(Vertex);
+    range.firstFloat = vertexBytes / sizeof(GLfloat);
+    range.stride = vertexSize / sizeof(GLfloat);
+    range.colorOffset =
+        mesh.positionOnly ? -1 : GLint(offsetof(Vertex, r) / sizeof(GLfloat));
+    range.firstIndex = -1;
+    vertexBytes += mesh.count * vertexSize;
+
+    GLint bytes = 0;
+    if (mesh.ebo) {
+      gl->glBindBuffer(GL_COPY_READ_BUFFER, mesh.ebo);
+      gl->glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &bytes);
+      range.firstIndex = indexBytes / sizeof(GLuint);
+      indexBytes += bytes;
+    }
+    elementBytes.append(bytes);
+    ranges.append(range);
+  }
+
+  gl->glGenBuffers(1, &vertexBuffer);
+  gl->glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+  gl->glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+  for (int i = 0; i < meshes.size(); i++) {
+    gl->glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].vbo);
+    gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                            ranges[i].firstFloat * sizeof(GLfloat),
+                            meshes[i].count * ranges[i].stride * sizeof(GLfloat));
+  }
+
+  // An empty texture buffer is incomplete, so there is always one index
+  gl->glGenBuffers(1, &indexBuffer);
+  gl->glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+  gl->glBufferData(GL_COPY_WRITE_BUFFER, qMax<GLsizeiptr>(indexBytes, 4),
+                   nullptr, GL_STATIC_DRAW);
+  allocatedBytes = vertexBytes + qMax<GLsizeiptr>(indexBytes, 4);
+  for (int i = 0; i < meshes.size(); i++) {
+    if (ranges[i].firstIndex < 0) continue;
+    gl->glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].ebo);
+    gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                            ranges[i].firstIndex * sizeof(GLuint),
+                            elementBytes[i]);
+  }
+  gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  gl->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  gl->glGenTextures(1, &vertexTexture);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, vertexTexture);
+  gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, vertexBuffer);
+  gl->glGenTextures(1, &indexTexture);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+  gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuffer);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  qDebug() << ":: Pooled" << vertexBytes + indexBytes
+           << "bytes of vertices and indices";
+}
+
+/**
+ * @brief VertexPool::destroy Deletes the buffers and textures.
+ * @param gl OpenGL functions of a current context of the group.
+ */
+void VertexPool::destroy(QOpenGLFunctions_3_3_Core *gl) {
+  GLuint buffers[] = {vertexBuffer, indexBuffer};
+  GLuint textures[] = {vertexTexture, indexTexture};
+  gl->glDeleteBuffers(2, buffers);
+  gl->glDeleteTextures(2, textures);
+  ranges.clear();
+  allocatedBytes = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef VERTEXPOOL_H
+#define VERTEXPOOL_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector>
+
+#include "mesh.h"
+
+/**
+ * @brief Vertex and index data of all meshes in two texture buffers, for
+ * programmable vertex pulling.
+ *
+ * The vertex buffers of the meshes are copied on the GPU into one buffer of
+ * floats and their element buffers into one buffer of indices, which a vertex
+ * shader reads with texelFetch. Every mesh keeps its own vertex layout; its
+ * range records where its data starts and how a vertex is laid out, so meshes
+ * of different formats are drawn by the same program.
+ */
+class VertexPool {
+ public:
+  struct Range {
+    GLint firstFloat;   // first float of the vertices
+    GLint stride;       // floats per vertex
+    GLint colorOffset;  // offset of the color in a vertex, -1 if it has none
+    GLint firstIndex;   // first index of the elements, -1 if not indexed
+  };
+
+  void build(QOpenGLFunctions_3_3_Core *gl, const QVector<Mesh> &meshes);
+  void destroy(QOpenGLFunctions_3_3_Core *gl);
+
+  bool contains(int mesh) const { return mesh < ranges.size(); }
+  const Range &getRange(int mesh) const { return ranges[mesh]; }
+  GLuint getVertexTexture() const { return vertexTexture; }
+  GLuint getIndexTexture() const { return indexTexture; }
+  qint64 getAllocatedBytes() const { return allocatedBytes; }
+
+ private:
+  QVector<Range> ranges;
+
+  GLuint vertexBuffer = 0;
+  GLuint indexBuffer = 0;
+  GLuint vertexTexture = 0;
+  GLuint indexTexture = 0;
+  qint64 allocatedBytes = 0;
+};
+
+#endif  // VERTEXPOOL_H
@@ -0,0 +1,103 @@
+#include "vertexpuller.h"
+
+/**
+ * @brief VertexPuller::initialize Creates the draw table and the vertex array
+ * without attributes.
+ * @param functions OpenGL functions of the current context.
+ */
+void VertexPuller::initialize(QOpenGLFunctions_3_3_Core *functions) {
+  gl = functions;
+
+  GLuint *buffers[] = {&headerBuffer, &transformBuffer};
+  GLuint *textures[] = {&headerTexture, &transformTexture};
+  GLenum formats[] = {GL_RGBA32I, GL_RGBA32F};
+  for (int i = 0; i < 2; i++) {
+    gl->glGenBuffers(1, buffers[i]);
+    gl->glBindBuffer(GL_TEXTURE_BUFFER, *buffers[i]);
+    gl->glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    gl->glGenTextures(1, textures[i]);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, *textures[i]);
+    gl->glTexBuffer(GL_TEXTURE_BUFFER, formats[i], *buffers[i]);
+  }
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+  gl->glGenVertexArrays(1, &vao);
+}
+
+/**
+ * @brief VertexPuller::destroy Deletes the draw table and the vertex array.
+ */
+void VertexPuller::destroy() {
+  if (!gl) return;
+  GLuint buffers[] = {headerBuffer, transformBuffer};
+  GLuint textures[] = {headerTexture, transformTexture};
+  gl->glDeleteBuffers(2, buffers);
+  gl->glDeleteTextures(2, textures);
+  gl->glDeleteVertexArrays(1, &vao);
+  gl = nullptr;
+}
+
+/**
+ * @brief VertexPuller::draw Draws the nodes at their levels of detail with a
+ * single draw call.
+ * @param program Bound pulling program.
+ * @param pool Pool holding the meshes.
+ * @param meshes Meshes referenced by the nodes, for their levels of detail.
+ * @param nodes Nodes to draw.
+ */
+void VertexPuller::draw(QOpenGLShaderProgram &program, const VertexPool &pool,
+                        const QVector<Mesh> &meshes,
+                        const QVector<SceneNode *> &nodes) {
+  if (nodes.isEmpty()) return;
+
+  headers.clear();
+  transforms.clear();
+  GLint vertexCount = 0;
+  for (SceneNode *node : nodes) {
+    // Meshes added after the pool was built, such as streamed models, are
+    // not pulled
+    if (!pool.contains(node->getMesh())) continue;
+    const Mesh &mesh = meshes[node->getMesh()];
+    const VertexPool::Range &range = pool.getRange(node->getMesh());
+    GLint firstIndex = -1;
+    GLint count = mesh.count;
+    if (range.firstIndex >= 0 && !mesh.lods.isEmpty()) {
+      const LodLevel &level = mesh.lods[node->getLod()];
+      firstIndex = range.firstIndex + level.first;
+      count = level.count;
+    }
+
+    headers.append({vertexCount, range.firstFloat, firstIndex,
+                    range.stride | (range.colorOffset + 1) << 8});
+    const float *transform = node->worldTransform().constData();
+    transforms.append(QVector<GLfloat>(transform, transform + 16));
+    vertexCount += count;
+  }
+
+  if (vertexCount == 0) return;
+
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, headerBuffer);
+  gl->glBufferData(GL_TEXTURE_BUFFER, headers.size() * sizeof(GLint),
+                   headers.constData(), GL_STREAM_DRAW);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+  gl->glBufferData(GL_TEXTURE_BUFFER, transforms.size() * sizeof(GLfloat),
+                   transforms.constData(), GL_STREAM_DRAW);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  GLuint textures[] = {pool.getVertexTexture(), pool.getIndexTexture(),
+                       headerTexture, transformTexture};
+  for (int i = 0; i < 4; i++) {
+    gl->glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+  }
+  gl->glActiveTexture(GL_TEXTURE0);
+  gl->glUniform1i(program.uniformLocation("vertexData"), firstUnit);
+  gl->glUniform1i(program.uniformLocation("indexData"), firstUnit + 1);
+  gl->glUniform1i(program.uniformLocation("drawHeaders"), firstUnit + 2);
+  gl->glUniform1i(program.uniformLocation("drawTransforms"), firstUnit + 3);
+  gl->glUniform1i(program.uniformLocation("drawCount"), headers.size() / 4);
+
+  gl->glBindVertexArray(vao);
+  gl->glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+  gl->glBindVertexArray(0);
+}
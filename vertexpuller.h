@@ -0,0 +1,48 @@
+#ifndef VERTEXPULLER_H
+#define VERTEXPULLER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+
+#include "mesh.h"
+#include "scenenode.h"
+#include "vertexpool.h"
+
+/**
+ * @brief Draws any number of nodes with one draw call by pulling their
+ * vertices from a vertex pool.
+ *
+ * Every frame, a table with one record per node is uploaded to texture
+ * buffers: the first vertex of the node within the draw, the range of its mesh
+ * in the pool, its level of detail and its world transformation. The vertex
+ * shader finds the record of gl_VertexID with a binary search and fetches the
+ * index and the attributes itself, so no vertex arrays are switched between
+ * meshes, whatever their vertex formats.
+ */
+class VertexPuller {
+ public:
+  // Texture units of the pool and the draw table
+  static constexpr int firstUnit = 6;
+
+  void initialize(QOpenGLFunctions_3_3_Core *functions);
+  void destroy();
+
+  void draw(QOpenGLShaderProgram &program, const VertexPool &pool,
+            const QVector<Mesh> &meshes, const QVector<SceneNode *> &nodes);
+
+ private:
+  QOpenGLFunctions_3_3_Core *gl = nullptr;
+
+  // The draw table: an integer header and the four columns of the world
+  // transformation per record
+  QVector<GLint> headers;
+  QVector<GLfloat> transforms;
+  GLuint headerBuffer = 0;
+  GLuint transformBuffer = 0;
+  GLuint headerTexture = 0;
+  GLuint transformTexture = 0;
+  GLuint vao = 0;
+};
+
+#endif  // VERTEXPULLER_H